@@ -4,6 +4,9 @@
 
 #define CSIMX307_WAIT_MS_CMD	5
 #define CSIMX307_WAIT_MS_STREAM	5
+/* how the mode download waits for LoadingDone */
+#define CSIMX307_READY_POLL_US	500
+#define CSIMX307_READY_TIMEOUT_MS	100
 
 typedef enum 
 {
@@ -17,44 +20,59 @@ typedef enum
 
 typedef enum
 {
+    /* generated by gen_regmap.sh from cs_regs.txt, do not edit */
+    //fpga
     deviceID = 0x00,
     HardWare = 0x01,
     LoadingDone = 0x02,
-
     Csi2_Enable = 0x03,
-    Fpga_CAP_L = 0x04,
-    Fpga_CAP_H = 0x05,
-    
-    TriggerMode = 0x10,
-    SlaveMode = 0x11,
-    TrigDly_H = 0x12,
-    TrigDly_M = 0x13,
-    TrigDly_U = 0x14,
-    TrigDly_L = 0x15,
-    VerTotalTime_H = 0x16,
-    VerTotalTime_L = 0x17,
-    HorTotalTime_H = 0x18,
-    HorTotalTime_L = 0x19,
+    CAM_CAP_L = 0x04,
+    CAM_CAP_H = 0x05,
+    I2c_addr = 0x06,
+    StreamMode = 0x0E,
+    SlaveMode = 0x0F,
+    StrobeIO_MODE = 0x10,
+    Strobe_sel = 0x11,
+    Strobe_value = 0x12,
+    TriggerIO_MODE = 0x14,
+    Trigger_sel = 0x15,
+    Trigger_value = 0x16,
+    ExtTrigEdge = 0x18,
+    ExtTrigDebouncerEn = 0x19,
+    ExtTrigDebouncerTimeL = 0x1A,
+    ExtTrigDebouncerTimeM = 0x1B,
+    ExtTrigDebouncerTimeH = 0x1C,
+    SoftTrig = 0x1D,
+    TrigDlyL = 0x1E,
+    TrigDlyM = 0x1F,
+    TrigDlyH = 0x20,
+    TrigDlyE = 0x21,
+    PickModeEnable = 0x26,
+    PickOne = 0x27,
+    DiscardedQnt = 0x28,
     YUV_SEQ = 0x28,
-    //for arm part
-    //for arm part
+    AutoTrigCntMaxL = 0xC7,
+    AutoTrigCntMaxM = 0xC8,
+    AutoTrigCntMaxH = 0xC9,
+    AutoTrigEnable = 0xCA,
+    MIPI_COUNT_L = 0xCE,
+    MIPI_COUNT_H = 0xCF,
+    MIPI_STAT = 0xD0,
+    //isp mcu
     ARM_VER_L = 0x0100,
     ARM_VER_H = 0x0101,
     PRODUCTID_L = 0x0102,
     PRODUCTID_H = 0x0103,
     SYSTEM_RESET = 0x0104,
     PARAM_SAVE = 0x0105,
-    VIDEOFMT_CAP = 0x0106, 
-    
+    VIDEOFMT_CAP = 0x0106,
     VIDEOFMT_NUM = 0x0107,
-
     FMTCAP_WIDTH_L = 0x0108,
     FMTCAP_WIDTH_H = 0x0109,
     FMTCAP_HEIGHT_L = 0x010A,
     FMTCAP_HEIGHT_H = 0x010B,
     FMTCAP_FRAMRAT_L = 0x010C,
     FMTCAP_FRAMRAT_H = 0x010D,
-    
     FMT_WIDTH_L = 0x0180,
     FMT_WIDTH_H = 0x0181,
     FMT_HEIGHT_L = 0x0182,
@@ -66,19 +84,25 @@ typedef enum
     NEW_FMT_FRAMRAT_MODE = 0x0188,
     NEW_FMT_FRAMRAT_L = 0x0189,
     NEW_FMT_FRAMRAT_H = 0x018A,
-    
+    ISP_CAP_L = 0x0200,
+    ISP_CAP_M = 0x0201,
+    ISP_CAP_H = 0x0202,
+    ISP_CAP_E = 0x0203,
+    POWER_HZ = 0x0204,
+    DAY_NIGHT_MODE = 0x0205,
+    CSC_HUE = 0x0206,
+    CSC_CONTT = 0x0207,
+    CSC_SATU = 0x0208,
     EXP_FRM_MODE = 0x020F,
     AE_MODE = 0x0210,
     EXP_TIME_L = 0x0211,
     EXP_TIME_M = 0x0212,
     EXP_TIME_H = 0x0213,
     EXP_TIME_E = 0x0214,
-
     AGAIN_NOW_DEC = 0x0215,
     AGAIN_NOW_INTER = 0x0216,
     DGAIN_NOW_DEC = 0x0217,
     DGAIN_NOW_INTER = 0x0218,
-
     AE_SPEED = 0x0219,
     AE_TARGET = 0x021A,
     AE_MAXTIME_L = 0x021B,
@@ -87,12 +111,41 @@ typedef enum
     AE_MAXTIME_E = 0x021E,
     AE_MAXGAIN_DEC = 0x021F,
     AE_MAXGAIN_INTER = 0x0220,
-    //ISP cap
-    ISP_CAP_L = 0x0200,
-    ISP_CAP_M = 0x0201,
-    ISP_CAP_H = 0x0202,
-    ISP_CAP_E = 0x0203,
-    POWER_HZ = 0x0204,
+    ME_TIME_L = 0x0226,
+    ME_TIME_M = 0x0227,
+    ME_TIME_H = 0x0228,
+    ME_TIME_E = 0x0229,
+    ME_AGAIN_DEC = 0x022A,
+    ME_AGAIN_INTER = 0x022B,
+    ME_DGAIN_DEC = 0x022C,
+    ME_DGAIN_INTER = 0x022D,
+    AE_SLOW_GAIN_DEC = 0x022E,
+    AE_SLOW_GAIN_INTER = 0x022F,
+    AWB_MODE = 0x0230,
+    WB_RGAIN = 0x0231,
+    WB_GGAIN = 0x0232,
+    WB_BGAIN = 0x0233,
+    WB_COLORTEMPL = 0x0235,
+    WB_COLORTEMPH = 0x0236,
+    MWB_COLORTEMPL = 0x023A,
+    MWB_COLORTEMPH = 0x023B,
+    MWB_RGAIN = 0x023C,
+    MWB_GGAIN = 0x023D,
+    MWB_BGAIN = 0x023E,
+    DME_TIME_L = 0x0240,
+    DME_TIME_M = 0x0241,
+    DME_TIME_H = 0x0242,
+    DME_TIME_E = 0x0243,
+    DME_AGAIN_DEC = 0x0244,
+    DME_AGAIN_INTER = 0x0245,
+    DME_DGAIN_DEC = 0x0246,
+    DME_DGAIN_INTER = 0x0247,
+    //sensor window
+    SNSOR_REG_FLG = 0x0700,
+    SNSOR_REG_ADDR_L = 0x0701,
+    SNSOR_REG_ADDR_H = 0x0702,
+    SNSOR_REG_VAL = 0x0703,
+    /* end of generated registers */
 }ECAMERA_REG;
 
 enum yuv_order {
@@ -186,19 +239,12 @@ struct csimx307 {
 	struct v4l2_pix_format pix;
 	const struct veye_datafmt	*fmt;
 	struct v4l2_captureparm streamcap;
+	/* in NEW_FMT_FRAMRAT units of 1/100 fps */
     u32 framerate;
+	/* mode last downloaded to the camera, -1 before the first one */
+	int cur_mode;
 	bool on;
 
-	/* control settings */
-	int brightness;
-	int hue;
-	int contrast;
-	int saturation;
-	int red;
-	int green;
-	int blue;
-	int ae_mode;
-
 	u32 mclk;
 	u8 mclk_source;
 	struct clk *sensor_clk;
@@ -206,6 +252,31 @@ struct csimx307 {
 
 	void (*io_init)(struct csimx307 *);
 	int pwn_gpio, rst_gpio;
+
+	struct regulator *io_regulator;
+	struct regulator *core_regulator;
+	struct regulator *analog_regulator;
+	/* serializes the subdev ops of this camera */
+	struct mutex lock;
+
+	struct v4l2_ctrl_handler ctrls;
+	struct v4l2_ctrl *framerate_ctrl;
+	struct {
+		/* exposure cluster, auto first */
+		struct v4l2_ctrl *exposure_auto;
+		struct v4l2_ctrl *exposure;
+		struct v4l2_ctrl *again;
+		struct v4l2_ctrl *dgain;
+	};
+
+	/* how long the firmware took to settle after mode steps, in debugfs */
+	struct dentry *debugfs;
+	u32 settle_count;
+	u32 settle_timeouts;
+	u32 settle_fallbacks;
+	u32 settle_last_us;
+	u32 settle_max_us;
+	u64 settle_total_us;
 };
 
 #endif
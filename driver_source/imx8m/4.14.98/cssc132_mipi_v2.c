@@ -4,7 +4,10 @@
 #include <linux/slab.h>
 #include <linux/ctype.h>
 #include <linux/types.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
+#include <linux/gcd.h>
+#include <linux/ktime.h>
 #include <linux/clk.h>
 #include <linux/of_device.h>
 #include <linux/i2c.h>
@@ -21,6 +24,19 @@
 #define CSSC132_VOLTAGE_DIGITAL_CORE         1500000//do not use
 #define CSSC132_VOLTAGE_DIGITAL_IO           2000000
 
+/* frame rate control, in NEW_FMT_FRAMRAT units of 1/100 fps */
+#define CSSC132_CID_FRAMERATE (V4L2_CID_CAMERA_CLASS_BASE | 0x1000)
+/* auto exposure tuning, the times are in us and the gains in 0.1 dB */
+#define CSSC132_CID_AE_SPEED (V4L2_CID_CAMERA_CLASS_BASE | 0x1001)
+#define CSSC132_CID_AE_TARGET (V4L2_CID_CAMERA_CLASS_BASE | 0x1002)
+#define CSSC132_CID_AE_MAXTIME (V4L2_CID_CAMERA_CLASS_BASE | 0x1003)
+#define CSSC132_CID_AE_MAXGAIN (V4L2_CID_CAMERA_CLASS_BASE | 0x1004)
+
+#define CSSC132_EXP_MAX 1000000
+#define CSSC132_GAIN_MAX (255 * 10 + 9)
+/* AE_MAXTIME value that leaves the limit to the firmware */
+#define CSSC132_AE_MAXTIME_AUTO 0xFFFFFFFF
+
 #define MIN_FPS 1
 #define MAX_FPS 45
 #define DEFAULT_FPS 45
@@ -28,17 +44,13 @@
 #define CSSC132_XCLK_MIN 6000000
 #define CSSC132_XCLK_MAX 24000000
 
-static struct regulator *io_regulator;
-static struct regulator *core_regulator;
-static struct regulator *analog_regulator;
-static struct regulator *gpo_regulator;
-static DEFINE_MUTEX(cssc132_mutex);
-
 static int cssc132_probe(struct i2c_client *adapter,
 				const struct i2c_device_id *device_id);
 static int cssc132_remove(struct i2c_client *client);
 
 static s32 cssc132_read_reg(struct cssc132 *sensor,u16 reg, u8 *val);
+static s32 cssc132_read_regs(struct cssc132 *sensor, u16 reg, u8 *val, int len);
+static s32 cssc132_write_regs(struct cssc132 *sensor, u16 reg, const u8 *val, int len);
 static s32 cssc132_write_reg(struct cssc132 *sensor,u16 reg, u8 val);
 
 static const struct i2c_device_id cssc132_id[] = {
@@ -67,10 +79,6 @@ static struct i2c_driver cssc132_i2c_driver = {
 	.id_table = cssc132_id,
 };
 
-/*
-static struct cssc132 cssc132_data;
-static int pwn_gpio, rst_gpio;
-*/
 static struct cssc132 *to_cssc132(const struct i2c_client *client)
 {
 	return container_of(i2c_get_clientdata(client), struct cssc132, subdev);
@@ -131,16 +139,17 @@ static void cssc132_reset(struct cssc132 *sensor)
 
 }
 
-static int cssc132_regulator_enable(struct device *dev)
+static int cssc132_regulator_enable(struct cssc132 *sensor)
 {
+	struct device *dev = &sensor->i2c_client->dev;
 	int ret = 0;
 
-	io_regulator = devm_regulator_get(dev, "DOVDD");
-	if (!IS_ERR(io_regulator)) {
-		regulator_set_voltage(io_regulator,
+	sensor->io_regulator = devm_regulator_get(dev, "DOVDD");
+	if (!IS_ERR(sensor->io_regulator)) {
+		regulator_set_voltage(sensor->io_regulator,
 				      CSSC132_VOLTAGE_DIGITAL_IO,
 				      CSSC132_VOLTAGE_DIGITAL_IO);
-		ret = regulator_enable(io_regulator);
+		ret = regulator_enable(sensor->io_regulator);
 		if (ret) {
 			dev_err(dev,"%s:io set voltage error\n", __func__);
 			return ret;
@@ -150,15 +159,15 @@ static int cssc132_regulator_enable(struct device *dev)
 		}
 	} else {
 		dev_err(dev,"%s: cannot get io voltage error\n", __func__);
-		io_regulator = NULL;
+		sensor->io_regulator = NULL;
 	}
 
-	core_regulator = devm_regulator_get(dev, "DVDD");
-	if (!IS_ERR(core_regulator)) {
-		regulator_set_voltage(core_regulator,
+	sensor->core_regulator = devm_regulator_get(dev, "DVDD");
+	if (!IS_ERR(sensor->core_regulator)) {
+		regulator_set_voltage(sensor->core_regulator,
 				      CSSC132_VOLTAGE_DIGITAL_CORE,
 				      CSSC132_VOLTAGE_DIGITAL_CORE);
-		ret = regulator_enable(core_regulator);
+		ret = regulator_enable(sensor->core_regulator);
 		if (ret) {
 			dev_err(dev,"%s:core set voltage error\n", __func__);
 			return ret;
@@ -167,16 +176,16 @@ static int cssc132_regulator_enable(struct device *dev)
 				"%s:core set voltage ok\n", __func__);
 		}
 	} else {
-		core_regulator = NULL;
+		sensor->core_regulator = NULL;
 		dev_err(dev,"%s: cannot get core voltage error\n", __func__);
 	}
 
-	analog_regulator = devm_regulator_get(dev, "AVDD");
-	if (!IS_ERR(analog_regulator)) {
-		regulator_set_voltage(analog_regulator,
+	sensor->analog_regulator = devm_regulator_get(dev, "AVDD");
+	if (!IS_ERR(sensor->analog_regulator)) {
+		regulator_set_voltage(sensor->analog_regulator,
 				      CSSC132_VOLTAGE_ANALOG,
 				      CSSC132_VOLTAGE_ANALOG);
-		ret = regulator_enable(analog_regulator);
+		ret = regulator_enable(sensor->analog_regulator);
 		if (ret) {
 			dev_err(dev,"%s:analog set voltage error\n",
 				__func__);
@@ -186,7 +195,7 @@ static int cssc132_regulator_enable(struct device *dev)
 				"%s:analog set voltage ok\n", __func__);
 		}
 	} else {
-		analog_regulator = NULL;
+		sensor->analog_regulator = NULL;
 		dev_err(dev,"%s: cannot get analog voltage error\n", __func__);
 	}
 
@@ -241,6 +250,89 @@ static s32 cssc132_read_reg(struct cssc132 *sensor,u16 reg, u8 *val)
 	return u8RdVal;
 }
 
+/*
+ * Multi-byte registers go over the bus in one transfer, so the firmware
+ * never sees a value that is only partly updated.
+ */
+static s32 cssc132_write_regs(struct cssc132 *sensor, u16 reg, const u8 *val, int len)
+{
+	u8 au8Buf[2 + 4] = {0};
+    struct device *dev = &sensor->i2c_client->dev;
+
+	if (len > sizeof(au8Buf) - 2)
+		return -EINVAL;
+	au8Buf[0] = reg >> 8;
+	au8Buf[1] = reg & 0xff;
+	memcpy(&au8Buf[2], val, len);
+
+	if (i2c_master_send(sensor->i2c_client, au8Buf, len + 2) != len + 2) {
+		dev_err(dev,"%s:write reg error:reg=%x,len=%d\n",
+			__func__, reg, len);
+		return -1;
+	}
+
+	return 0;
+}
+
+static s32 cssc132_read_regs(struct cssc132 *sensor, u16 reg, u8 *val, int len)
+{
+	struct i2c_client *client = sensor->i2c_client;
+	u8 au8RegBuf[2] = {0};
+	struct i2c_msg msgs[2] = {
+		{ .addr = client->addr, .flags = 0,
+		  .len = 2, .buf = au8RegBuf },
+		{ .addr = client->addr, .flags = I2C_M_RD,
+		  .len = len, .buf = val },
+	};
+
+	au8RegBuf[0] = reg >> 8;
+	au8RegBuf[1] = reg & 0xff;
+
+	if (i2c_transfer(client->adapter, msgs, 2) != 2) {
+		dev_err(&client->dev,"%s:read reg error:reg=%x,len=%d\n",
+			__func__, reg, len);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* 32 bit values are little endian, from the _L register on */
+static s32 cssc132_write_u32(struct cssc132 *sensor, u16 reg, u32 val)
+{
+	u8 buf[4] = { val, val >> 8, val >> 16, val >> 24 };
+
+	return cssc132_write_regs(sensor, reg, buf, 4);
+}
+
+static s32 cssc132_read_u32(struct cssc132 *sensor, u16 reg, u32 *val)
+{
+	u8 buf[4];
+
+	if (cssc132_read_regs(sensor, reg, buf, 4) < 0)
+		return -1;
+	*val = buf[0] | buf[1] << 8 | buf[2] << 16 | (u32)buf[3] << 24;
+	return 0;
+}
+
+/* gains are a _DEC register with the tenths, then _INTER with whole dB */
+static s32 cssc132_write_gain(struct cssc132 *sensor, u16 reg, u32 val)
+{
+	u8 buf[2] = { val % 10, val / 10 };
+
+	return cssc132_write_regs(sensor, reg, buf, 2);
+}
+
+static s32 cssc132_read_gain(struct cssc132 *sensor, u16 reg, s32 *val)
+{
+	u8 buf[2];
+
+	if (cssc132_read_regs(sensor, reg, buf, 2) < 0)
+		return -1;
+	*val = buf[1] * 10 + buf[0];
+	return 0;
+}
+
 
 static void cssc132_stream_on(struct cssc132 *sensor)
 {
@@ -253,6 +345,67 @@ static void cssc132_stream_off(struct cssc132 *sensor)
 	cssc132_write_reg(sensor,Csi2_Enable, 0x00);
     msleep(CSSC132_WAIT_MS_STREAM);
 }
+/*
+ * Wait for the firmware to report LoadingDone after a mode step instead of
+ * sleeping through its worst case. LoadingDone may still be set from the
+ * step before, so only a drop to 0 and the return to 1 count as ready.
+ * Without a drop within the fixed delay of the step, or when LoadingDone
+ * can not be read, the step gets that fixed delay as before.
+ */
+static void cssc132_wait_ready(struct cssc132 *sensor, u32 fallback_ms)
+{
+	struct device *dev = &sensor->i2c_client->dev;
+	ktime_t start = ktime_get();
+	bool loading = false;
+	u32 us;
+	u8 val;
+
+	for (;;) {
+		if (cssc132_read_reg(sensor, LoadingDone, &val) < 0) {
+			sensor->settle_fallbacks++;
+			msleep(fallback_ms);
+			return;
+		}
+		us = ktime_us_delta(ktime_get(), start);
+		if (val != 0x01)
+			loading = true;
+		else if (loading)
+			break;
+		if (!loading && us >= fallback_ms * 1000) {
+			sensor->settle_fallbacks++;
+			return;
+		}
+		if (us >= CSSC132_READY_TIMEOUT_MS * 1000) {
+			dev_warn(dev, "firmware not ready after %u us\n", us);
+			sensor->settle_timeouts++;
+			break;
+		}
+		usleep_range(CSSC132_READY_POLL_US, 2 * CSSC132_READY_POLL_US);
+	}
+
+	sensor->settle_count++;
+	sensor->settle_last_us = us;
+	sensor->settle_max_us = max(sensor->settle_max_us, us);
+	sensor->settle_total_us += us;
+}
+
+static void cssc132_debugfs_init(struct cssc132 *sensor)
+{
+	struct device *dev = &sensor->i2c_client->dev;
+	char name[32];
+
+	snprintf(name, sizeof(name), "cssc132-%s", dev_name(dev));
+	sensor->debugfs = debugfs_create_dir(name, NULL);
+	if (IS_ERR_OR_NULL(sensor->debugfs))
+		return;
+	debugfs_create_u32("settle_count", 0444, sensor->debugfs, &sensor->settle_count);
+	debugfs_create_u32("settle_timeouts", 0444, sensor->debugfs, &sensor->settle_timeouts);
+	debugfs_create_u32("settle_fallbacks", 0444, sensor->debugfs, &sensor->settle_fallbacks);
+	debugfs_create_u32("settle_last_us", 0444, sensor->debugfs, &sensor->settle_last_us);
+	debugfs_create_u32("settle_max_us", 0444, sensor->debugfs, &sensor->settle_max_us);
+	debugfs_create_u64("settle_total_us", 0444, sensor->debugfs, &sensor->settle_total_us);
+}
+
 /* download cssc132 settings to sensor through i2c */
 static int cssc132_download_firmware(struct cssc132 *sensor,struct reg_value *pModeSetting, s32 ArySize)
 {
@@ -284,11 +437,21 @@ static int cssc132_download_firmware(struct cssc132 *sensor,struct reg_value *pM
 			goto err;
 
 		if (Delay_ms)
-			msleep(Delay_ms);
+			cssc132_wait_ready(sensor, Delay_ms);
 	}
 err:
 	return retval;
 }
+/* the frame rate the firmware runs at, and the interval g_parm reports */
+static void cssc132_update_framerate(struct cssc132 *sensor, u32 fps_x100)
+{
+	u32 div = gcd(fps_x100, 100);
+
+	sensor->framerate = fps_x100;
+	sensor->streamcap.timeperframe.numerator = 100 / div;
+	sensor->streamcap.timeperframe.denominator = fps_x100 / div;
+}
+
 /* if sensor changes inside scaling or subsampling
  * change mode directly
  * */
@@ -326,7 +489,6 @@ static int cssc132_change_mode_direct(struct cssc132 *sensor,u32 frame_rate,
 		cssc132_mode_info_data[mode].width;
 	sensor->pix.height =
 		cssc132_mode_info_data[mode].height;
-    sensor->framerate = frame_rate;
 	if (sensor->pix.width == 0 || sensor->pix.height == 0 || ArySize == 0)
     {
         dev_err(dev,"cssc132_change_mode_direct failed EINVAL! \n");
@@ -338,15 +500,253 @@ static int cssc132_change_mode_direct(struct cssc132 *sensor,u32 frame_rate,
     dev_info(dev,"set cssc132 %x %x \n",reg_list[3].u16RegAddr,reg_list[3].u8Val);
     dev_info(dev,"set cssc132 %x %x \n",reg_list[4].u16RegAddr,reg_list[4].u8Val);
     dev_info(dev,"set cssc132 %x %x \n",reg_list[5].u16RegAddr,reg_list[5].u8Val);*/
+	/* FMT_FRAMRAT only counts with the new frame rate mode off */
+	retval = cssc132_write_reg(sensor, NEW_FMT_FRAMRAT_MODE, 0);
+	if (retval < 0)
+		goto err;
+
 	/* Write capture setting */
 	retval = cssc132_download_firmware(sensor,reg_list, ArySize);
 	if (retval < 0)
 		goto err;
+	cssc132_update_framerate(sensor, frame_rate * 100);
+	sensor->cur_mode = mode;
 
 err:
 	return retval;
 }
 
+/*
+ * Change the frame rate of the loaded mode through NEW_FMT_FRAMRAT, the
+ * firmware takes it over while streaming, without reloading the mode.
+ */
+static int cssc132_set_framerate(struct cssc132 *sensor, u32 fps_x100)
+{
+	struct device *dev = &sensor->i2c_client->dev;
+	const struct cssc132_mode_info *mode;
+	u8 size[4], rate[3];
+	int retval;
+
+	if (fps_x100 == sensor->framerate)
+		return 0;
+	if (sensor->cur_mode < 0)
+		return -EINVAL;
+	mode = &cssc132_mode_info_data[sensor->cur_mode];
+	if (fps_x100 > mode->max_framerate * 100 || fps_x100 < MIN_FPS * 100)
+		return -EINVAL;
+
+	/*
+	 * The current size first, then the rate, as write_videofmt in
+	 * cs_mipi_i2c.sh does. Each goes in one burst so the firmware
+	 * never sees half a value.
+	 */
+	size[0] = mode->width & 0xFF;
+	size[1] = (mode->width >> 8) & 0xFF;
+	size[2] = mode->height & 0xFF;
+	size[3] = (mode->height >> 8) & 0xFF;
+	retval = cssc132_write_regs(sensor, FMT_WIDTH_L, size, sizeof(size));
+	if (retval < 0)
+		return retval;
+	rate[0] = 1;
+	rate[1] = fps_x100 & 0xFF;
+	rate[2] = (fps_x100 >> 8) & 0xFF;
+	retval = cssc132_write_regs(sensor, NEW_FMT_FRAMRAT_MODE, rate, sizeof(rate));
+	if (retval < 0)
+		return retval;
+
+	dev_dbg(dev, "frame rate %u.%02u\n", fps_x100 / 100, fps_x100 % 100);
+	cssc132_update_framerate(sensor, fps_x100);
+	return 0;
+}
+
+/*
+ * The exposure cluster: AE_MODE selects between the firmware's auto
+ * exposure and the ME_* manual registers. In auto mode the exposure and
+ * gain controls read back what the firmware currently uses.
+ */
+static int cssc132_s_exposure(struct cssc132 *sensor, struct v4l2_ctrl *ctrl)
+{
+	bool manual = ctrl->val == V4L2_EXPOSURE_MANUAL;
+	int ret = 0;
+
+	if (manual) {
+		/* on the switch to manual load all of them, not only new ones */
+		if (ctrl->is_new || sensor->exposure->is_new)
+			ret = cssc132_write_u32(sensor, ME_TIME_L, sensor->exposure->val);
+		if (!ret && (ctrl->is_new || sensor->again->is_new))
+			ret = cssc132_write_gain(sensor, ME_AGAIN_DEC, sensor->again->val);
+		if (!ret && (ctrl->is_new || sensor->dgain->is_new))
+			ret = cssc132_write_gain(sensor, ME_DGAIN_DEC, sensor->dgain->val);
+	}
+	if (!ret && ctrl->is_new)
+		ret = cssc132_write_reg(sensor, AE_MODE, manual ? 1 : 0);
+	return ret;
+}
+
+static int cssc132_g_volatile_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct cssc132 *sensor = container_of(ctrl->handler, struct cssc132, ctrls);
+	u32 exptime;
+
+	switch (ctrl->id) {
+	case V4L2_CID_EXPOSURE_AUTO:
+		if (cssc132_read_u32(sensor, EXP_TIME_L, &exptime) < 0 ||
+		    cssc132_read_gain(sensor, AGAIN_NOW_DEC, &sensor->again->val) < 0 ||
+		    cssc132_read_gain(sensor, DGAIN_NOW_DEC, &sensor->dgain->val) < 0)
+			return -EIO;
+		sensor->exposure->val = min_t(u32, exptime, CSSC132_EXP_MAX);
+		return 0;
+	}
+	return -EINVAL;
+}
+
+static int cssc132_s_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct cssc132 *sensor = container_of(ctrl->handler, struct cssc132, ctrls);
+	int ret;
+
+	switch (ctrl->id) {
+	case CSSC132_CID_FRAMERATE:
+		return cssc132_set_framerate(sensor, ctrl->val);
+	case V4L2_CID_EXPOSURE_AUTO:
+		ret = cssc132_s_exposure(sensor, ctrl);
+		break;
+	case CSSC132_CID_AE_SPEED:
+		ret = cssc132_write_reg(sensor, AE_SPEED, ctrl->val);
+		break;
+	case CSSC132_CID_AE_TARGET:
+		ret = cssc132_write_reg(sensor, AE_TARGET, ctrl->val);
+		break;
+	case CSSC132_CID_AE_MAXTIME:
+		ret = cssc132_write_u32(sensor, AE_MAXTIME_L,
+				  ctrl->val ? ctrl->val : CSSC132_AE_MAXTIME_AUTO);
+		break;
+	case CSSC132_CID_AE_MAXGAIN:
+		ret = cssc132_write_gain(sensor, AE_MAXGAIN_DEC, ctrl->val);
+		break;
+	default:
+		return -EINVAL;
+	}
+	return ret < 0 ? -EIO : 0;
+}
+
+static const struct v4l2_ctrl_ops cssc132_ctrl_ops = {
+	.g_volatile_ctrl = cssc132_g_volatile_ctrl,
+	.s_ctrl = cssc132_s_ctrl,
+};
+
+static const struct v4l2_ctrl_config cssc132_ae_speed = {
+	.ops = &cssc132_ctrl_ops,
+	.id = CSSC132_CID_AE_SPEED,
+	.name = "AE Speed",
+	.type = V4L2_CTRL_TYPE_INTEGER,
+	.max = 255,
+	.step = 1,
+};
+
+static const struct v4l2_ctrl_config cssc132_ae_target = {
+	.ops = &cssc132_ctrl_ops,
+	.id = CSSC132_CID_AE_TARGET,
+	.name = "AE Target",
+	.type = V4L2_CTRL_TYPE_INTEGER,
+	.max = 255,
+	.step = 1,
+};
+
+/* 0 leaves the longest exposure to the firmware */
+static const struct v4l2_ctrl_config cssc132_ae_maxtime = {
+	.ops = &cssc132_ctrl_ops,
+	.id = CSSC132_CID_AE_MAXTIME,
+	.name = "AE Max Exposure us",
+	.type = V4L2_CTRL_TYPE_INTEGER,
+	.max = CSSC132_EXP_MAX,
+	.step = 1,
+};
+
+static const struct v4l2_ctrl_config cssc132_ae_maxgain = {
+	.ops = &cssc132_ctrl_ops,
+	.id = CSSC132_CID_AE_MAXGAIN,
+	.name = "AE Max Gain 0.1dB",
+	.type = V4L2_CTRL_TYPE_INTEGER,
+	.max = CSSC132_GAIN_MAX,
+	.step = 1,
+};
+
+static struct v4l2_ctrl *cssc132_new_custom(struct cssc132 *sensor,
+				      const struct v4l2_ctrl_config *cfg, s64 def)
+{
+	struct v4l2_ctrl_config c = *cfg;
+
+	c.def = clamp_t(s64, def, c.min, c.max);
+	return v4l2_ctrl_new_custom(&sensor->ctrls, &c, NULL);
+}
+
+static int cssc132_init_controls(struct cssc132 *sensor)
+{
+	struct v4l2_ctrl_config framerate = {
+		.ops = &cssc132_ctrl_ops,
+		.id = CSSC132_CID_FRAMERATE,
+		.name = "Frame Rate x100",
+		.type = V4L2_CTRL_TYPE_INTEGER,
+		.min = MIN_FPS * 100,
+		.step = 1,
+		.def = sensor->framerate,
+	};
+	const struct v4l2_ctrl_ops *ops = &cssc132_ctrl_ops;
+	struct v4l2_ctrl_handler *hdl = &sensor->ctrls;
+	u8 ae_mode = 0, ae_speed = 0, ae_target = 0;
+	u32 exptime = 0, maxtime = 0;
+	s32 again = 0, dgain = 0, maxgain = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(cssc132_mode_info_data); i++)
+		framerate.max = max_t(s64, framerate.max,
+				      cssc132_mode_info_data[i].max_framerate * 100);
+
+	/* the camera keeps these in flash, start from what it holds */
+	cssc132_read_reg(sensor, AE_MODE, &ae_mode);
+	cssc132_read_u32(sensor, ME_TIME_L, &exptime);
+	cssc132_read_gain(sensor, ME_AGAIN_DEC, &again);
+	cssc132_read_gain(sensor, ME_DGAIN_DEC, &dgain);
+	cssc132_read_reg(sensor, AE_SPEED, &ae_speed);
+	cssc132_read_reg(sensor, AE_TARGET, &ae_target);
+	cssc132_read_u32(sensor, AE_MAXTIME_L, &maxtime);
+	cssc132_read_gain(sensor, AE_MAXGAIN_DEC, &maxgain);
+	if (maxtime == CSSC132_AE_MAXTIME_AUTO)
+		maxtime = 0;
+
+	v4l2_ctrl_handler_init(hdl, 9);
+	hdl->lock = &sensor->lock;
+	sensor->framerate_ctrl = v4l2_ctrl_new_custom(hdl, &framerate, NULL);
+
+	sensor->exposure_auto = v4l2_ctrl_new_std_menu(hdl, ops,
+			V4L2_CID_EXPOSURE_AUTO, V4L2_EXPOSURE_MANUAL,
+			~(BIT(V4L2_EXPOSURE_AUTO) | BIT(V4L2_EXPOSURE_MANUAL)),
+			ae_mode ? V4L2_EXPOSURE_MANUAL : V4L2_EXPOSURE_AUTO);
+	sensor->exposure = v4l2_ctrl_new_std(hdl, ops, V4L2_CID_EXPOSURE,
+			1, CSSC132_EXP_MAX, 1, clamp_t(u32, exptime, 1, CSSC132_EXP_MAX));
+	sensor->again = v4l2_ctrl_new_std(hdl, ops, V4L2_CID_ANALOGUE_GAIN,
+			0, CSSC132_GAIN_MAX, 1, again);
+	sensor->dgain = v4l2_ctrl_new_std(hdl, ops, V4L2_CID_DIGITAL_GAIN,
+			0, CSSC132_GAIN_MAX, 1, dgain);
+
+	cssc132_new_custom(sensor, &cssc132_ae_speed, ae_speed);
+	cssc132_new_custom(sensor, &cssc132_ae_target, ae_target);
+	cssc132_new_custom(sensor, &cssc132_ae_maxtime, maxtime);
+	cssc132_new_custom(sensor, &cssc132_ae_maxgain, maxgain);
+
+	if (hdl->error) {
+		int ret = hdl->error;
+
+		v4l2_ctrl_handler_free(&sensor->ctrls);
+		return ret;
+	}
+	v4l2_ctrl_auto_cluster(4, &sensor->exposure_auto,
+			       V4L2_EXPOSURE_MANUAL, true);
+	sensor->subdev.ctrl_handler = &sensor->ctrls;
+	return 0;
+}
+
 static int cssc132_init_mode(struct cssc132 *sensor,u32 frame_rate,
 			    enum cssc132_mode mode)
 {
@@ -369,7 +769,7 @@ static int cssc132_init_mode(struct cssc132 *sensor,u32 frame_rate,
 		goto err;
    
 	msec_wait4stable = 30;
-	msleep(msec_wait4stable);
+	cssc132_wait_ready(sensor, msec_wait4stable);
 
 err:
 	return retval;
@@ -388,33 +788,34 @@ static int cssc132_s_power(struct v4l2_subdev *sd, int on)
 	struct i2c_client *client = v4l2_get_subdevdata(sd);
 	struct cssc132 *sensor = to_cssc132(client);
 
+	mutex_lock(&sensor->lock);
 	if (on && !sensor->on) {
-		if (io_regulator)
-			if (regulator_enable(io_regulator) != 0)
-				return -EIO;
-		if (core_regulator)
-			if (regulator_enable(core_regulator) != 0)
-				return -EIO;
-		if (gpo_regulator)
-			if (regulator_enable(gpo_regulator) != 0)
-				return -EIO;
-		if (analog_regulator)
-			if (regulator_enable(analog_regulator) != 0)
-				return -EIO;
+		if (sensor->io_regulator)
+			if (regulator_enable(sensor->io_regulator) != 0)
+				goto err_io;
+		if (sensor->core_regulator)
+			if (regulator_enable(sensor->core_regulator) != 0)
+				goto err_io;
+		if (sensor->analog_regulator)
+			if (regulator_enable(sensor->analog_regulator) != 0)
+				goto err_io;
 	} else if (!on && sensor->on) {
-		if (analog_regulator)
-			regulator_disable(analog_regulator);
-		if (core_regulator)
-			regulator_disable(core_regulator);
-		if (io_regulator)
-			regulator_disable(io_regulator);
-		if (gpo_regulator)
-			regulator_disable(gpo_regulator);
+		if (sensor->analog_regulator)
+			regulator_disable(sensor->analog_regulator);
+		if (sensor->core_regulator)
+			regulator_disable(sensor->core_regulator);
+		if (sensor->io_regulator)
+			regulator_disable(sensor->io_regulator);
 	}
 
 	sensor->on = on;
+	mutex_unlock(&sensor->lock);
 
 	return 0;
+
+err_io:
+	mutex_unlock(&sensor->lock);
+	return -EIO;
 }
 
 /*!
@@ -432,6 +833,7 @@ static int cssc132_g_parm(struct v4l2_subdev *sd, struct v4l2_streamparm *a)
 	struct v4l2_captureparm *cparm = &a->parm.capture;
 	int ret = 0;
 
+	mutex_lock(&sensor->lock);
 	switch (a->type) {
 	/* This is the only case currently handled. */
 	case V4L2_BUF_TYPE_VIDEO_CAPTURE:
@@ -460,9 +862,53 @@ static int cssc132_g_parm(struct v4l2_subdev *sd, struct v4l2_streamparm *a)
 		break;
 	}
 
+	mutex_unlock(&sensor->lock);
+
 	return ret;
 }
 
+/*
+ * Apply a frame interval, called with sensor->lock held. The interval is
+ * rounded to the 1/100 fps of NEW_FMT_FRAMRAT and clamped to what the mode
+ * can do, timeperframe returns what was actually set. While the mode stays
+ * the same only the frame rate changes, on the fly; a new mode is
+ * downloaded in full at the next integer rate first.
+ */
+static int cssc132_set_interval(struct cssc132 *sensor, enum cssc132_mode new_mode,
+			  struct v4l2_fract *timeperframe)
+{
+	u32 fps_x100;	/* target frames per secound, in 1/100 */
+	int ret;
+
+	/* Check that the new frame rate is allowed. */
+	if ((timeperframe->numerator == 0) ||
+	    (timeperframe->denominator == 0)) {
+		timeperframe->denominator = DEFAULT_FPS;
+		timeperframe->numerator = 1;
+	}
+	fps_x100 = min_t(u64, div_u64((u64)timeperframe->denominator * 100 +
+				      timeperframe->numerator / 2,
+				      timeperframe->numerator), U32_MAX);
+	fps_x100 = clamp_t(u32, fps_x100, MIN_FPS * 100,
+			   cssc132_mode_info_data[new_mode].max_framerate * 100);
+
+	if (new_mode != sensor->cur_mode) {
+		ret = cssc132_init_mode(sensor, DIV_ROUND_UP(fps_x100, 100), new_mode);
+		if (ret < 0)
+			return ret;
+	}
+	ret = cssc132_set_framerate(sensor, fps_x100);
+	if (ret < 0)
+		return ret;
+	/* sync the control, set_framerate() finds nothing left to write */
+	__v4l2_ctrl_s_ctrl(sensor->framerate_ctrl, sensor->framerate);
+
+	/* Actual frame rate we use */
+	*timeperframe = sensor->streamcap.timeperframe;
+	sensor->streamcap.capturemode = new_mode;
+	return 0;
+}
+
 /*!
  * cssc132_s_parm - V4L2 sensor interface handler for VIDIOC_S_PARM ioctl
  * @s: pointer to standard V4L2 sub device structure
@@ -478,11 +924,10 @@ static int cssc132_s_parm(struct v4l2_subdev *sd, struct v4l2_streamparm *a)
 	struct cssc132 *sensor = to_cssc132(client);
 	struct device *dev = &sensor->i2c_client->dev;
 	struct v4l2_fract *timeperframe = &a->parm.capture.timeperframe;
-	u32 tgt_fps;	/* target frames per secound */
-	//u32 frame_rate;
 	enum cssc132_mode new_mode;
 	int ret = 0;
 
+	mutex_lock(&sensor->lock);
 	switch (a->type) {
 	/* This is the only case currently handled. */
     //set framerate and mode here
@@ -496,33 +941,7 @@ static int cssc132_s_parm(struct v4l2_subdev *sd, struct v4l2_streamparm *a)
             ret = -EINVAL;
             break;
 		} 
-		/* Check that the new frame rate is allowed. */
-		if ((timeperframe->numerator == 0) ||
-		    (timeperframe->denominator == 0)) {
-			timeperframe->denominator = DEFAULT_FPS;
-			timeperframe->numerator = 1;
-		}
-		tgt_fps = timeperframe->denominator /
-			  timeperframe->numerator;
-		if (tgt_fps > cssc132_mode_info_data[new_mode].max_framerate) {
-			timeperframe->denominator = cssc132_mode_info_data[new_mode].max_framerate;
-			timeperframe->numerator = 1;
-		} else if (tgt_fps < MIN_FPS) {
-			timeperframe->denominator = MIN_FPS;
-			timeperframe->numerator = 1;
-		}
-		/* Actual frame rate we use */
-		tgt_fps = timeperframe->denominator /
-			  timeperframe->numerator;
-    
-		//orig_mode = sensor->streamcap.capturemode;
-		ret = cssc132_init_mode(sensor,tgt_fps,new_mode);
-		if (ret < 0)
-			return ret;
-
-		sensor->streamcap.timeperframe = *timeperframe;
-		sensor->streamcap.capturemode =
-				new_mode;
+		ret = cssc132_set_interval(sensor, new_mode, timeperframe);
 		break;
 	/* These are all the possible cases. */
 	case V4L2_BUF_TYPE_VIDEO_OUTPUT:
@@ -543,6 +962,8 @@ static int cssc132_s_parm(struct v4l2_subdev *sd, struct v4l2_streamparm *a)
 		break;
 	}
 
+	mutex_unlock(&sensor->lock);
+
 	return ret;
 }
 
@@ -563,6 +984,11 @@ static int cssc132_set_fmt(struct v4l2_subdev *sd,
         fmt		= &veye_colour_fmts[0];
 	}
 	mf->field	= V4L2_FIELD_NONE;
+
+	if (format->which == V4L2_SUBDEV_FORMAT_TRY)
+		return 0;
+
+	mutex_lock(&sensor->lock);
     
     if(mf->code == MEDIA_BUS_FMT_YUYV8_2X8){
         cssc132_write_reg(sensor,YUV_SEQ, 0x1);//yuyv
@@ -573,9 +999,6 @@ static int cssc132_set_fmt(struct v4l2_subdev *sd,
         sensor->pix.pixelformat = V4L2_PIX_FMT_UYVY; 
         dev_info(dev,"set pixel format UYVY\n");
     }
-	if (format->which == V4L2_SUBDEV_FORMAT_TRY)
-		return 0;
-
 	sensor->fmt = fmt;
     
 	capturemode = get_capturemode(mf->width, mf->height);
@@ -583,9 +1006,10 @@ static int cssc132_set_fmt(struct v4l2_subdev *sd,
 		sensor->streamcap.capturemode = capturemode;
 		sensor->pix.width = mf->width;
 		sensor->pix.height = mf->height;
-		return 0;
 	}
     
+	mutex_unlock(&sensor->lock);
+
 	return 0;
 }
 
@@ -667,20 +1091,26 @@ static int cssc132_enum_frameintervals(struct v4l2_subdev *sd,
 	struct device *dev = &client->dev;
 	int i=0;
 
-	if (fie->index < CSSC132_mode_MIN || fie->index > CSSC132_mode_MAX)
-		return -EINVAL;
-
 	if (fie->width == 0 || fie->height == 0 ||
 	    fie->code == 0) {
 		dev_warn(dev, "Please assign pixel format, width and height\n");
 		return -EINVAL;
 	}
-	fie->interval.numerator = 1;
+	/*
+	 * Any interval between these two works, in steps of 1/100 fps. The
+	 * pad op can only enumerate discrete values, so list the bounds of
+	 * the range: index 0 is the shortest interval, index 1 the longest.
+	 */
+	if (fie->index > 1)
+		return -EINVAL;
     for (i = 0; i < (CSSC132_mode_MAX + 1); i++) {
         if (fie->width == cssc132_mode_info_data[i].width
          && fie->height == cssc132_mode_info_data[i].height
          && cssc132_mode_info_data[i].init_data_ptr != NULL) {
-             fie->interval.denominator = cssc132_mode_info_data[i].max_framerate;
+		fie->interval.numerator = 1;
+		fie->interval.denominator = fie->index == 0 ?
+			cssc132_mode_info_data[i].max_framerate : MIN_FPS;
+		return 0;
         }
     }
     
@@ -724,16 +1154,47 @@ static int cssc132_s_stream(struct v4l2_subdev *sd, int enable)
 	struct cssc132 *sensor = to_cssc132(client);
 	struct device *dev = &sensor->i2c_client->dev;
 	dev_info(dev, "cssc132_s_stream: %d\n", enable);
+	mutex_lock(&sensor->lock);
 	if (enable)
 		cssc132_stream_on(sensor);
 	else
 		cssc132_stream_off(sensor);
+	mutex_unlock(&sensor->lock);
 	return 0;
 }
 
+static int cssc132_g_frame_interval(struct v4l2_subdev *sd,
+				 struct v4l2_subdev_frame_interval *fi)
+{
+	struct i2c_client *client = v4l2_get_subdevdata(sd);
+	struct cssc132 *sensor = to_cssc132(client);
+
+	mutex_lock(&sensor->lock);
+	fi->interval = sensor->streamcap.timeperframe;
+	mutex_unlock(&sensor->lock);
+	return 0;
+}
+
+/* keeps the current mode, so this may be used while streaming */
+static int cssc132_s_frame_interval(struct v4l2_subdev *sd,
+				 struct v4l2_subdev_frame_interval *fi)
+{
+	struct i2c_client *client = v4l2_get_subdevdata(sd);
+	struct cssc132 *sensor = to_cssc132(client);
+	int ret;
+
+	mutex_lock(&sensor->lock);
+	ret = cssc132_set_interval(sensor, sensor->streamcap.capturemode,
+			     &fi->interval);
+	mutex_unlock(&sensor->lock);
+	return ret;
+}
+
 static struct v4l2_subdev_video_ops cssc132_subdev_video_ops = {
 	.g_parm = cssc132_g_parm,
 	.s_parm = cssc132_s_parm,
+	.g_frame_interval = cssc132_g_frame_interval,
+	.s_frame_interval = cssc132_s_frame_interval,
 	.s_stream = cssc132_s_stream,
 };
 
@@ -809,6 +1270,9 @@ static int cssc132_probe(struct i2c_client *client,
 	int retval;
 	struct cssc132 *sensor;
 	sensor = devm_kzalloc(dev, sizeof(*sensor), GFP_KERNEL);
+	if (!sensor)
+		return -ENOMEM;
+	mutex_init(&sensor->lock);
 	/* cssc132 pinctrl */
 	pinctrl = devm_pinctrl_get_select_default(dev);
 	if (IS_ERR(pinctrl)) {
@@ -885,9 +1349,10 @@ static int cssc132_probe(struct i2c_client *client,
 	sensor->streamcap.capturemode = 0;
 	sensor->streamcap.timeperframe.denominator = DEFAULT_FPS;
 	sensor->streamcap.timeperframe.numerator = 1;
-    sensor->framerate = DEFAULT_FPS;
+    sensor->framerate = DEFAULT_FPS * 100;
+	sensor->cur_mode = -1;
     
-	cssc132_regulator_enable(&client->dev);
+	cssc132_regulator_enable(sensor);
 
 	cssc132_reset(sensor);
 
@@ -900,9 +1365,12 @@ static int cssc132_probe(struct i2c_client *client,
 	}
     //set camera yuv seq to yuyv  format
     cssc132_write_reg(sensor,YUV_SEQ, 0x1);
-   
+
+	cssc132_debugfs_init(sensor);
+
 	retval = init_device(sensor);
 	if (retval < 0) {
+		debugfs_remove_recursive(sensor->debugfs);
 		clk_disable_unprepare(sensor->sensor_clk);
 		pr_warning("camera cssc132 init failed\n");
 		cssc132_power_down(sensor,1);
@@ -911,6 +1379,15 @@ static int cssc132_probe(struct i2c_client *client,
 
 	v4l2_i2c_subdev_init(&sensor->subdev, client, &cssc132_subdev_ops);
 
+	retval = cssc132_init_controls(sensor);
+	if (retval < 0) {
+		dev_err(dev, "failed to init controls (%d)\n", retval);
+		debugfs_remove_recursive(sensor->debugfs);
+		clk_disable_unprepare(sensor->sensor_clk);
+		cssc132_power_down(sensor,1);
+		return retval;
+	}
+
 	sensor->subdev.grp_id = 9527;
 	retval = v4l2_async_register_subdev(&sensor->subdev);
 	if (retval < 0)
@@ -934,22 +1411,21 @@ static int cssc132_remove(struct i2c_client *client)
 	struct cssc132 *sensor = to_cssc132(client);
 
 	v4l2_async_unregister_subdev(sd);
+	v4l2_ctrl_handler_free(&sensor->ctrls);
+	debugfs_remove_recursive(sensor->debugfs);
 
 	clk_disable_unprepare(sensor->sensor_clk);
 
 	cssc132_power_down(sensor,1);
 
-	if (gpo_regulator)
-		regulator_disable(gpo_regulator);
-
-	if (analog_regulator)
-		regulator_disable(analog_regulator);
+	if (sensor->analog_regulator)
+		regulator_disable(sensor->analog_regulator);
 
-	if (core_regulator)
-		regulator_disable(core_regulator);
+	if (sensor->core_regulator)
+		regulator_disable(sensor->core_regulator);
 
-	if (io_regulator)
-		regulator_disable(io_regulator);
+	if (sensor->io_regulator)
+		regulator_disable(sensor->io_regulator);
 
 	return 0;
 }
@@ -95,6 +95,12 @@ struct veye327 {
 
 	void (*io_init)(struct veye327 *);
 	int pwn_gpio, rst_gpio;
+
+	struct regulator *io_regulator;
+	struct regulator *core_regulator;
+	struct regulator *analog_regulator;
+	/* serializes the subdev ops of this camera */
+	struct mutex lock;
 };
 /*!
  * Maintains the information on the current state of the sesor.
@@ -130,12 +136,6 @@ static struct veye327_mode_info veye327_mode_info_data[2][veye327_mode_MAX + 1]
 	},
 };
 
-static struct regulator *io_regulator;
-static struct regulator *core_regulator;
-static struct regulator *analog_regulator;
-static struct regulator *gpo_regulator;
-static DEFINE_MUTEX(veye327_mutex);
-
 static int veye327_probe(struct i2c_client *adapter,
 				const struct i2c_device_id *device_id);
 static int veye327_remove(struct i2c_client *client);
@@ -175,11 +175,6 @@ static const struct veye327_datafmt veye327_colour_fmts[] = {
     {MEDIA_BUS_FMT_UYVY8_2X8, V4L2_COLORSPACE_REC709},
 };
 
-//todo here
-/*
-static struct veye327 veye327_data;
-static int pwn_gpio, rst_gpio;
-*/
 static struct veye327 *to_veye327(const struct i2c_client *client)
 {
 	return container_of(i2c_get_clientdata(client), struct veye327, subdev);
@@ -228,16 +223,17 @@ static void veye327_reset(struct veye327 *sensor)
 
 }
 
-static int veye327_regulator_enable(struct device *dev)
+static int veye327_regulator_enable(struct veye327 *sensor)
 {
+	struct device *dev = &sensor->i2c_client->dev;
 	int ret = 0;
 
-	io_regulator = devm_regulator_get(dev, "DOVDD");
-	if (!IS_ERR(io_regulator)) {
-		regulator_set_voltage(io_regulator,
+	sensor->io_regulator = devm_regulator_get(dev, "DOVDD");
+	if (!IS_ERR(sensor->io_regulator)) {
+		regulator_set_voltage(sensor->io_regulator,
 				      VEYE327_VOLTAGE_DIGITAL_IO,
 				      VEYE327_VOLTAGE_DIGITAL_IO);
-		ret = regulator_enable(io_regulator);
+		ret = regulator_enable(sensor->io_regulator);
 		if (ret) {
 			dev_err(dev,"%s:io set voltage error\n", __func__);
 			return ret;
@@ -247,15 +243,15 @@ static int veye327_regulator_enable(struct device *dev)
 		}
 	} else {
 		dev_err(dev,"%s: cannot get io voltage error\n", __func__);
-		io_regulator = NULL;
+		sensor->io_regulator = NULL;
 	}
 
-	core_regulator = devm_regulator_get(dev, "DVDD");
-	if (!IS_ERR(core_regulator)) {
-		regulator_set_voltage(core_regulator,
+	sensor->core_regulator = devm_regulator_get(dev, "DVDD");
+	if (!IS_ERR(sensor->core_regulator)) {
+		regulator_set_voltage(sensor->core_regulator,
 				      VEYE327_VOLTAGE_DIGITAL_CORE,
 				      VEYE327_VOLTAGE_DIGITAL_CORE);
-		ret = regulator_enable(core_regulator);
+		ret = regulator_enable(sensor->core_regulator);
 		if (ret) {
 			dev_err(dev,"%s:core set voltage error\n", __func__);
 			return ret;
@@ -264,16 +260,16 @@ static int veye327_regulator_enable(struct device *dev)
 				"%s:core set voltage ok\n", __func__);
 		}
 	} else {
-		core_regulator = NULL;
+		sensor->core_regulator = NULL;
 		dev_err(dev,"%s: cannot get core voltage error\n", __func__);
 	}
 
-	analog_regulator = devm_regulator_get(dev, "AVDD");
-	if (!IS_ERR(analog_regulator)) {
-		regulator_set_voltage(analog_regulator,
+	sensor->analog_regulator = devm_regulator_get(dev, "AVDD");
+	if (!IS_ERR(sensor->analog_regulator)) {
+		regulator_set_voltage(sensor->analog_regulator,
 				      VEYE327_VOLTAGE_ANALOG,
 				      VEYE327_VOLTAGE_ANALOG);
-		ret = regulator_enable(analog_regulator);
+		ret = regulator_enable(sensor->analog_regulator);
 		if (ret) {
 			dev_err(dev,"%s:analog set voltage error\n",
 				__func__);
@@ -283,7 +279,7 @@ static int veye327_regulator_enable(struct device *dev)
 				"%s:analog set voltage ok\n", __func__);
 		}
 	} else {
-		analog_regulator = NULL;
+		sensor->analog_regulator = NULL;
 		dev_err(dev,"%s: cannot get analog voltage error\n", __func__);
 	}
 
@@ -474,33 +470,34 @@ static int veye327_s_power(struct v4l2_subdev *sd, int on)
 	struct i2c_client *client = v4l2_get_subdevdata(sd);
 	struct veye327 *sensor = to_veye327(client);
 
+	mutex_lock(&sensor->lock);
 	if (on && !sensor->on) {
-		if (io_regulator)
-			if (regulator_enable(io_regulator) != 0)
-				return -EIO;
-		if (core_regulator)
-			if (regulator_enable(core_regulator) != 0)
-				return -EIO;
-		if (gpo_regulator)
-			if (regulator_enable(gpo_regulator) != 0)
-				return -EIO;
-		if (analog_regulator)
-			if (regulator_enable(analog_regulator) != 0)
-				return -EIO;
+		if (sensor->io_regulator)
+			if (regulator_enable(sensor->io_regulator) != 0)
+				goto err_io;
+		if (sensor->core_regulator)
+			if (regulator_enable(sensor->core_regulator) != 0)
+				goto err_io;
+		if (sensor->analog_regulator)
+			if (regulator_enable(sensor->analog_regulator) != 0)
+				goto err_io;
 	} else if (!on && sensor->on) {
-		if (analog_regulator)
-			regulator_disable(analog_regulator);
-		if (core_regulator)
-			regulator_disable(core_regulator);
-		if (io_regulator)
-			regulator_disable(io_regulator);
-		if (gpo_regulator)
-			regulator_disable(gpo_regulator);
+		if (sensor->analog_regulator)
+			regulator_disable(sensor->analog_regulator);
+		if (sensor->core_regulator)
+			regulator_disable(sensor->core_regulator);
+		if (sensor->io_regulator)
+			regulator_disable(sensor->io_regulator);
 	}
 
 	sensor->on = on;
+	mutex_unlock(&sensor->lock);
 
 	return 0;
+
+err_io:
+	mutex_unlock(&sensor->lock);
+	return -EIO;
 }
 
 /*!
@@ -518,6 +515,7 @@ static int veye327_g_parm(struct v4l2_subdev *sd, struct v4l2_streamparm *a)
 	struct v4l2_captureparm *cparm = &a->parm.capture;
 	int ret = 0;
 
+	mutex_lock(&sensor->lock);
 	switch (a->type) {
 	/* This is the only case currently handled. */
 	case V4L2_BUF_TYPE_VIDEO_CAPTURE:
@@ -545,6 +543,8 @@ static int veye327_g_parm(struct v4l2_subdev *sd, struct v4l2_streamparm *a)
 		break;
 	}
 
+	mutex_unlock(&sensor->lock);
+
 	return ret;
 }
 
@@ -569,6 +569,7 @@ static int veye327_s_parm(struct v4l2_subdev *sd, struct v4l2_streamparm *a)
 	int ret = 0;
 
 
+	mutex_lock(&sensor->lock);
 	switch (a->type) {
 	/* This is the only case currently handled. */
 	case V4L2_BUF_TYPE_VIDEO_CAPTURE:
@@ -600,14 +601,15 @@ static int veye327_s_parm(struct v4l2_subdev *sd, struct v4l2_streamparm *a)
 			frame_rate = veye327_30_fps;
 		else {
 			dev_err(dev," The camera frame rate is not supported!\n");
-			return -EINVAL;
+			ret = -EINVAL;
+			break;
 		}
 
 		orig_mode = sensor->streamcap.capturemode;
 		ret = veye327_init_mode(sensor,frame_rate,
 				(u32)a->parm.capture.capturemode, orig_mode);
 		if (ret < 0)
-			return ret;
+			break;
 
 		sensor->streamcap.timeperframe = *timeperframe;
 		sensor->streamcap.capturemode =
@@ -634,6 +636,8 @@ static int veye327_s_parm(struct v4l2_subdev *sd, struct v4l2_streamparm *a)
 		break;
 	}
 
+	mutex_unlock(&sensor->lock);
+
 	return ret;
 }
 
@@ -654,6 +658,11 @@ static int veye327_set_fmt(struct v4l2_subdev *sd,
 	}
     
 	mf->field	= V4L2_FIELD_NONE;
+
+	if (format->which == V4L2_SUBDEV_FORMAT_TRY)
+		return 0;
+
+	mutex_lock(&sensor->lock);
     
     if(mf->code == MEDIA_BUS_FMT_YUYV8_2X8){
         veye327_write_reg(sensor,VEYE327_REG_YUV_SEQ, 0x1);//yuyv
@@ -665,11 +674,10 @@ static int veye327_set_fmt(struct v4l2_subdev *sd,
         dev_info(dev,"set pixel format UYVY\n");
     }
 
-	if (format->which == V4L2_SUBDEV_FORMAT_TRY)
-		return 0;
-
 	sensor->fmt = fmt;
 
+	mutex_unlock(&sensor->lock);
+
 	return 0;
 }
 
@@ -828,10 +836,12 @@ static int veye327_s_stream(struct v4l2_subdev *sd, int enable)
 	struct veye327 *sensor = to_veye327(client);
 	struct device *dev = &sensor->i2c_client->dev;
 	dev_info(dev, "s_stream: %d\n", enable);
+	mutex_lock(&sensor->lock);
 	if (enable)
 		veye327_stream_on(sensor);
 	else
 		veye327_stream_off(sensor);
+	mutex_unlock(&sensor->lock);
 	return 0;
 }
 
@@ -879,6 +889,9 @@ static int veye327_probe(struct i2c_client *client,
 	struct veye327 *sensor;
 	u8 chip_id;
 	sensor = devm_kzalloc(dev, sizeof(*sensor), GFP_KERNEL);
+	if (!sensor)
+		return -ENOMEM;
+	mutex_init(&sensor->lock);
 	/* veye327 pinctrl */
 	pinctrl = devm_pinctrl_get_select_default(dev);
 	if (IS_ERR(pinctrl)) {
@@ -955,7 +968,7 @@ static int veye327_probe(struct i2c_client *client,
 	sensor->streamcap.timeperframe.denominator = DEFAULT_FPS;
 	sensor->streamcap.timeperframe.numerator = 1;
 
-	veye327_regulator_enable(&client->dev);
+	veye327_regulator_enable(sensor);
 
 	veye327_reset(sensor);
 
@@ -1008,17 +1021,14 @@ static int veye327_remove(struct i2c_client *client)
 
 	veye327_power_down(sensor,1);
 
-	if (gpo_regulator)
-		regulator_disable(gpo_regulator);
-
-	if (analog_regulator)
-		regulator_disable(analog_regulator);
+	if (sensor->analog_regulator)
+		regulator_disable(sensor->analog_regulator);
 
-	if (core_regulator)
-		regulator_disable(core_regulator);
+	if (sensor->core_regulator)
+		regulator_disable(sensor->core_regulator);
 
-	if (io_regulator)
-		regulator_disable(io_regulator);
+	if (sensor->io_regulator)
+		regulator_disable(sensor->io_regulator);
 
 	return 0;
 }
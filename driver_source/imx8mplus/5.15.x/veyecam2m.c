@@ -15,18 +15,27 @@
 #include <linux/clk.h>
 #include <linux/clk-provider.h>
 #include <linux/clkdev.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/gpio/consumer.h>
 #include <linux/i2c.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/pm_runtime.h>
+#include <linux/regmap.h>
 #include <linux/regulator/consumer.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
 #include <media/v4l2-ctrls.h>
 #include <media/v4l2-device.h>
 #include <media/v4l2-event.h>
 #include <media/v4l2-fwnode.h>
 #include <media/v4l2-mediabus.h>
 #include <asm/unaligned.h>
+
+#define CREATE_TRACE_POINTS
+#include "veyecam2m_trace.h"
 // VEYE-MIPI-IMX327S
 // VEYE-MIPI-IMX462
 // VEYE-MIPI-IMX385
@@ -48,39 +57,198 @@
 // we do not need it
 #define VEYECAM2M_XCLK_FREQ		24000000
 
-/* Pixel rate is fixed at 74.25M for all the modes */
-#define VEYECAM2M_PIXEL_RATE		74250000
 /*mipi clk is 297Mhz */
 #define VEYECAM2M_DEFAULT_LINK_FREQ	297000000
+/* bits per pixel on the CSI-2 link, the camera sends YUV 4:2:2 */
+#define VEYECAM2M_BPP			16
+#define VEYECAM2M_MAX_LINK_FREQS	4
 
 
 #define VEYECAM2M_XCLR_MIN_DELAY_US	6000
 #define VEYECAM2M_XCLR_DELAY_RANGE_US	1000
-#define VEYECAM2M_REG_YUV_SEQ         0x001e
-/* veyecam2m model register address */
-#define VEYECAM2M_MODEL_ID_ADDR		0x0001
-#define VEYECAM2M_DEVICE_ID 		0x06
 
-#define SENSOR_TYPR_ADDR_L    0x20
-#define SENSOR_TYPR_ADDR_H    0x21
+/* how often and how long to wait for the camera to answer after power on */
+#define VEYECAM2M_BOOT_POLL_MS		5
+#define VEYECAM2M_BOOT_TIMEOUT_MS	1000
+/* power cycles before probe gives up on the camera */
+#define VEYECAM2M_PROBE_ATTEMPTS	3
 
-#define BOARD_TYPR_ADDR    0x25
+/* keep an idle camera powered this long, a quick reopen skips the boot */
+#define VEYECAM2M_AUTOSUSPEND_DELAY_MS	2000
 
 /* registers */
-#define VEYECAM_STREAMING_ON    0x001D
+/* generated by gen_regmap.sh from veye_regs.txt, do not edit */
+/* camera registers */
+#define VEYECAM2M_REG_HW_VERSION         0x00
+#define VEYECAM2M_REG_DEVICE_ID          0x01
+#define VEYECAM2M_REG_DAY_NIGHT          0x02
+#define VEYECAM2M_REG_MIPI_CLK_MODE      0x0B
+#define VEYECAM2M_REG_ISP_ADDR_H         0x10
+#define VEYECAM2M_REG_ISP_ADDR_L         0x11
+#define VEYECAM2M_REG_ISP_WVAL           0x12
+#define VEYECAM2M_REG_ISP_CMD            0x13
+#define VEYECAM2M_REG_ISP_RVAL           0x14
+#define VEYECAM2M_REG_IR_TRIGGER         0x15
+#define VEYECAM2M_REG_IRCUT_DIR          0x16
+#define VEYECAM2M_REG_CAMERA_MODE        0x1A
+#define VEYECAM2M_REG_NODF               0x1B
+#define VEYECAM2M_REG_CAPTURE            0x1C
+#define VEYECAM2M_REG_STREAM_ON          0x1D
+#define VEYECAM2M_REG_YUV_SEQ            0x1E
+#define VEYECAM2M_REG_I2C_AUX            0x1F
+#define VEYECAM2M_REG_SENSOR_ID_L        0x20
+#define VEYECAM2M_REG_SENSOR_ID_H        0x21
+#define VEYECAM2M_REG_I2C_WR_EN          0x24
+#define VEYECAM2M_REG_BOARD_TYPE         0x25
+/* isp parameters */
+#define VEYECAM2M_ISP_CONTRAST           0x495B
+#define VEYECAM2M_ISP_AWB_RGAIN          0x5E0B
+#define VEYECAM2M_ISP_AWB_BGAIN          0x5E0F
+#define VEYECAM2M_ISP_SATURATION0        0xD87A
+#define VEYECAM2M_ISP_SATURATION1        0xD87B
+#define VEYECAM2M_ISP_DENOISE            0xD89B
+#define VEYECAM2M_ISP_DEFOG              0xD92F
+#define VEYECAM2M_ISP_SHARPEN_VAL        0xD952
+#define VEYECAM2M_ISP_SHARPEN_EN         0xD95D
+#define VEYECAM2M_ISP_MGAIN_H            0xDA06
+#define VEYECAM2M_ISP_AGC_SPEED          0xDA18
+#define VEYECAM2M_ISP_BRIGHTNESS_PAL     0xDA1A
+#define VEYECAM2M_ISP_SHUTTER_SPEED      0xDA1B
+#define VEYECAM2M_ISP_MSHUTTER_H         0xDA1C
+#define VEYECAM2M_ISP_MSHUTTER_L         0xDA1D
+#define VEYECAM2M_ISP_MGAIN_L            0xDA1E
+#define VEYECAM2M_ISP_ANTIFLICKER        0xDA1F
+#define VEYECAM2M_ISP_MWB_BGAIN          0xDA29
+#define VEYECAM2M_ISP_MWB_RGAIN          0xDA2E
+#define VEYECAM2M_ISP_WB_MODE            0xDA34
+#define VEYECAM2M_ISP_PARAM_SAVE         0xDA53
+#define VEYECAM2M_ISP_LOWLIGHT           0xDA64
+#define VEYECAM2M_ISP_BRIGHTNESS_NTSC    0xDA65
+#define VEYECAM2M_ISP_MSHUTTER_OLD       0xDA66
+#define VEYECAM2M_ISP_AE_MODE            0xDA67
+#define VEYECAM2M_ISP_WDR_MODE           0xDB32
+#define VEYECAM2M_ISP_MIRROR             0xDE57
+#define VEYECAM2M_ISP_VIDEO_FORMAT       0xDEC2
+/* end of generated registers */
+
+#define VEYECAM2M_DEVICE_ID 		0x06
+
 #define VEYECAM_MODE_STANDBY		0x00
 #define VEYECAM_MODE_STREAMING		0x01
 
-//static int debug = 0;
+/* ISP window commands, ISP_CMD */
+#define VEYECAM2M_ISP_CMD_WRITE		0x00
+#define VEYECAM2M_ISP_CMD_READ		0x01
+/* the ISP wants this long between two window commands */
+#define VEYECAM2M_ISP_CMD_DELAY_US	10000
+/* most ISP parameters a single control writes */
+#define VEYECAM2M_ISP_MAX_GROUP		5
+
+/* VIDEO_FORMAT, the video standard sets the frame rate */
+#define VEYECAM2M_VIDEO_FORMAT_PAL	0x00
+#define VEYECAM2M_VIDEO_FORMAT_NTSC	0x01
+#define VEYECAM2M_FRAMERATE_PAL		25
+#define VEYECAM2M_FRAMERATE_NTSC	30
+
+/* YUV_SEQ, byte order on the bus */
+#define VEYECAM2M_YUV_SEQ_UYVY		0x00
+#define VEYECAM2M_YUV_SEQ_YUYV		0x01
+
+#define VEYECAM2M_WIDTH			1920
+#define VEYECAM2M_HEIGHT		1080
+
+#define VEYECAM2M_AE_MODE_MANUAL	0x80
+#define VEYECAM2M_WB_MODE_AUTO		0x18
+#define VEYECAM2M_WB_MODE_MANUAL	0x1A
+#define VEYECAM2M_ANTIFLICKER_ON	0x40
+#define VEYECAM2M_SHARPEN_VAL_LOW	0x03
+
+/* sensor ids, SENSOR_ID_L << 8 | SENSOR_ID_H */
+#define VEYECAM2M_SENSOR_IMX327		0x0327
+#define VEYECAM2M_SENSOR_IMX462		0x0462
+#define VEYECAM2M_SENSOR_IMX385		0x0385
+
+/* manual gain is in 0.3dB steps, 0.1dB on IMX385, up to 72dB */
+#define VEYECAM2M_MGAIN_MAX		240
+#define VEYECAM2M_MGAIN_MAX_IMX385	720
+/* manual shutter is in lines */
+#define VEYECAM2M_MSHUTTER_MAX		0xffff
+#define VEYECAM2M_MSHUTTER_DEFAULT	1125
+
+/* camera features without a standard control */
+#define VEYECAM2M_CID_BASE		(V4L2_CID_CAMERA_CLASS_BASE | 0x1000)
+#define VEYECAM2M_CID_WDR_MODE		(VEYECAM2M_CID_BASE + 0)
+#define VEYECAM2M_CID_DENOISE		(VEYECAM2M_CID_BASE + 1)
+#define VEYECAM2M_CID_LOWLIGHT		(VEYECAM2M_CID_BASE + 2)
+#define VEYECAM2M_CID_DAY_NIGHT		(VEYECAM2M_CID_BASE + 3)
+#define VEYECAM2M_CID_META		(VEYECAM2M_CID_BASE + 4)
+#define VEYECAM2M_CID_META_PERIOD	(VEYECAM2M_CID_BASE + 5)
+
+/* a new struct veyecam2m_meta snapshot, in the event data */
+#define VEYECAM2M_EVENT_META		(V4L2_EVENT_PRIVATE_START + 1)
+/* snapshots kept per subscriber */
+#define VEYECAM2M_META_EVENTS		8
+#define VEYECAM2M_META_PERIOD_MAX_MS	10000
+
+/* veyecam2m_meta.flags, exposure and gain hold what the camera applies */
+#define VEYECAM2M_META_EXPOSURE		BIT(0)
 
-struct veyecam2m_reg {
-	u16 address;
+/*
+ * Exposure and white balance snapshot, the payload of the metadata
+ * control and event. The camera sends no embedded data lines, so the
+ * driver reads the values back while streaming. timestamp is
+ * CLOCK_MONOTONIC like the buffer timestamps of the capture device and
+ * marks when the snapshot began, match it against those to find the
+ * frame. The white balance gains are the live ones the AWB applies. The
+ * camera has no readable live exposure, so exposure and gain are only
+ * filled in, with VEYECAM2M_META_EXPOSURE, while a manual exposure set
+ * through the controls is in effect.
+ */
+struct veyecam2m_meta {
+	__u64 timestamp;
+	__u32 sequence;
+	__u32 flags;
+	/* lines */
+	__u16 exposure;
+	/* MGAIN steps, 0.3dB or 0.1dB on IMX385 */
+	__u16 gain;
+	__u8 red_gain;
+	__u8 blue_gain;
+	/* enum v4l2_exposure_auto_type */
+	__u8 exposure_auto;
+	__u8 wb_auto;
+	__u8 reserved[4];
+} __packed;
+
+struct veyecam2m_isp_val {
+	u16 addr;
 	u8 val;
 };
 
+/* a control that is one raw register byte, as veye_mipi_i2c.sh sets it */
+struct veyecam2m_raw_ctrl {
+	u32 id;
+	const char *name;
+	u16 reg;
+	/* reg is an ISP parameter behind the window */
+	bool isp;
+};
+
+static const struct veyecam2m_raw_ctrl veyecam2m_raw_ctrls[] = {
+	{ VEYECAM2M_CID_WDR_MODE, "WDR Mode", VEYECAM2M_ISP_WDR_MODE, true },
+	{ VEYECAM2M_CID_DENOISE, "Denoise", VEYECAM2M_ISP_DENOISE, true },
+	{ VEYECAM2M_CID_LOWLIGHT, "Low Light", VEYECAM2M_ISP_LOWLIGHT, true },
+	{ VEYECAM2M_CID_DAY_NIGHT, "Day Night Mode", VEYECAM2M_REG_DAY_NIGHT, false },
+};
+
+/* controls in the handler, standard ones first */
+#define VEYECAM2M_NUM_CTRLS	(17 + ARRAY_SIZE(veyecam2m_raw_ctrls))
+
+//static int debug = 0;
+
 struct veyecam2m_reg_list {
 	u32 num_of_regs;
-	const struct veyecam2m_reg *regs;
+	const struct reg_sequence *regs;
 };
 
 /* Mode : resolution and related config&values */
@@ -102,8 +270,67 @@ struct veyecam2m_mode {
 	VEYECAM2M_NUM_MODES,
 };*/
 
-static const struct veyecam2m_reg mode_1920_1080_regs[] = {
+/* operations timed in debugfs */
+enum veyecam2m_stat_op {
+	VEYECAM2M_STAT_WRITE_REG,
+	VEYECAM2M_STAT_READ_REG,
+	VEYECAM2M_STAT_WRITE_REGS,
+	VEYECAM2M_STAT_START_STREAMING,
+	VEYECAM2M_STAT_STOP_STREAMING,
+	VEYECAM2M_STAT_POWER_ON,
+	VEYECAM2M_STAT_POWER_OFF,
+	VEYECAM2M_STAT_NUM_OPS,
+};
 
+static const char * const veyecam2m_stat_names[] = {
+	[VEYECAM2M_STAT_WRITE_REG] = "write_reg",
+	[VEYECAM2M_STAT_READ_REG] = "read_reg",
+	[VEYECAM2M_STAT_WRITE_REGS] = "write_regs",
+	[VEYECAM2M_STAT_START_STREAMING] = "start_streaming",
+	[VEYECAM2M_STAT_STOP_STREAMING] = "stop_streaming",
+	[VEYECAM2M_STAT_POWER_ON] = "power_on",
+	[VEYECAM2M_STAT_POWER_OFF] = "power_off",
+};
+
+/* latency buckets are powers of two in us, the last one takes the rest */
+#define VEYECAM2M_STAT_BUCKETS		21
+#define VEYECAM2M_STAT_HISTORY		32
+
+struct veyecam2m_op_stat {
+	u64 count;
+	u64 errors;
+	u64 total_us;
+	u64 max_us;
+	u64 buckets[VEYECAM2M_STAT_BUCKETS];
+};
+
+struct veyecam2m_xfer {
+	ktime_t time;
+	u32 us;
+	u8 op;
+	u16 reg;
+	u32 val;
+	u32 len;
+	int ret;
+};
+
+struct veyecam2m_stats {
+	spinlock_t lock;
+	struct veyecam2m_op_stat ops[VEYECAM2M_STAT_NUM_OPS];
+	/* ring of the last transactions, head is the next slot */
+	struct veyecam2m_xfer history[VEYECAM2M_STAT_HISTORY];
+	unsigned int head;
+	unsigned int num;
+};
+
+/* CSI-2 configurations the camera firmware can drive, by ascending frequency */
+struct veyecam2m_link {
+	u32 lanes;
+	s64 link_freq;
+};
+
+static const struct veyecam2m_link veyecam2m_links[] = {
+	{ 2, VEYECAM2M_DEFAULT_LINK_FREQ },
 };
 
 #define		REGULATOR	0
@@ -116,20 +343,6 @@ static const char * const veyecam2m_supply_name[] = {
 
 #define VEYECAM2M_NUM_SUPPLIES ARRAY_SIZE(veyecam2m_supply_name)
 
-/* Mode configs */
-static const struct veyecam2m_mode supported_modes[] = {
-	{
-		/* 1080P 30fps  */
-		.width = 1920,
-		.height = 1080,
-		//.vts_def = veyecam2m_VTS_30FPS_1080P,
-		.reg_list = {
-			.num_of_regs = ARRAY_SIZE(mode_1920_1080_regs),
-			.regs = mode_1920_1080_regs,
-		},
-	},
-};
-
 struct veyecam2m {
 	struct v4l2_subdev sd;
 	struct media_pad pad;
@@ -137,6 +350,7 @@ struct veyecam2m {
 	struct v4l2_mbus_framefmt fmt;
 	//add here
 	struct v4l2_fwnode_endpoint ep; /* the parsed DT endpoint info */
+	struct regmap *regmap;
 	struct clk *xclk; /* system clock to VEYECAM2M */
 	u32 xclk_freq;
 
@@ -146,15 +360,43 @@ struct veyecam2m {
 	struct v4l2_ctrl_handler ctrl_handler;
 	/* V4L2 Controls */
 	struct v4l2_ctrl *pixel_rate;
+	struct v4l2_ctrl *link_freq;
+	/* exposure cluster */
+	struct v4l2_ctrl *exposure_auto;
 	struct v4l2_ctrl *exposure;
+	struct v4l2_ctrl *gain;
+	/* white balance cluster */
+	struct v4l2_ctrl *wb_auto;
+	struct v4l2_ctrl *red_balance;
+	struct v4l2_ctrl *blue_balance;
+	/* flip cluster */
 	struct v4l2_ctrl *vflip;
 	struct v4l2_ctrl *hflip;
 	struct v4l2_ctrl *vblank;
 	struct v4l2_ctrl *hblank;
-
+	struct v4l2_ctrl *meta_period;
+
+	/* AE_MODE without the manual bit, read when exposure is first set */
+	u8 ae_mode;
+	bool ae_mode_read;
+	/* cluster masters set since probe, the only ones stream on restores */
+	struct v4l2_ctrl *set_ctrls[VEYECAM2M_NUM_CTRLS];
+	unsigned int num_set_ctrls;
+	bool restoring;
+	u16 sensor_id;
+
+	/* Modes the camera reported at probe */
+	struct veyecam2m_mode *modes;
+	unsigned int num_modes;
 	/* Current mode */
 	const struct veyecam2m_mode *mode;
 
+	/* CSI-2 link from the DT, the usable link frequencies ascending */
+	u32 num_lanes;
+	s64 link_freqs[VEYECAM2M_MAX_LINK_FREQS];
+	unsigned int num_link_freqs;
+	unsigned int link_freq_index;
+
 	/*
 	 * Mutex for serialized access:
 	 * Protect sensor module set pad format and start/stop streaming safely.
@@ -163,6 +405,23 @@ struct veyecam2m {
 
 	/* Streaming on/off */
 	bool streaming;
+	/* holds a runtime PM reference for the legacy s_power op */
+	bool powered;
+	/* supplies are on, while off regmap writes only reach its cache */
+	bool power_on;
+
+	/* metadata snapshots while streaming, protected by mutex */
+	struct delayed_work meta_work;
+	struct veyecam2m_meta meta;
+
+	/* identification and registration, once the camera has booted */
+	struct delayed_work probe_work;
+	ktime_t probe_start;
+	unsigned int probe_attempts;
+	bool registered;
+
+	struct veyecam2m_stats stats;
+	struct dentry *debugfs;
 };
 
 static inline struct veyecam2m *to_veyecam2m(struct v4l2_subdev *_sd)
@@ -171,83 +430,262 @@ static inline struct veyecam2m *to_veyecam2m(struct v4l2_subdev *_sd)
 }
 
 
+/*
+ * Camera registers go through regmap. The cache only covers the plain
+ * configuration registers of the camera (DAY_NIGHT, MIPI_CLK_MODE,
+ * YUV_SEQ and their neighbours); there are no defaults, so a power cycle
+ * replays every one of them the driver has read or written. The ISP
+ * window, the capture trigger and STREAM_ON always go to the camera, and
+ * so does the identification block, which probe reads in one burst. ISP
+ * parameters are not cached at all, the control handler applies them
+ * again at stream on.
+ */
+static bool veyecam2m_writeable_reg(struct device *dev, unsigned int reg)
+{
+	switch (reg) {
+	case VEYECAM2M_REG_HW_VERSION:
+	case VEYECAM2M_REG_DEVICE_ID:
+	case VEYECAM2M_REG_ISP_RVAL:
+	case VEYECAM2M_REG_SENSOR_ID_L:
+	case VEYECAM2M_REG_SENSOR_ID_H:
+	case VEYECAM2M_REG_BOARD_TYPE:
+		return false;
+	}
+	return true;
+}
+
+static bool veyecam2m_volatile_reg(struct device *dev, unsigned int reg)
+{
+	switch (reg) {
+	case VEYECAM2M_REG_DEVICE_ID:
+	case VEYECAM2M_REG_ISP_ADDR_H ... VEYECAM2M_REG_ISP_RVAL:
+	case VEYECAM2M_REG_CAPTURE:
+	case VEYECAM2M_REG_STREAM_ON:
+	case VEYECAM2M_REG_SENSOR_ID_L ... VEYECAM2M_REG_BOARD_TYPE:
+		return true;
+	}
+	return false;
+}
+
+/*
+ * While the camera is powered down regmap only updates its cache, and a
+ * write to a volatile register would be dropped without a word. Refuse
+ * those instead.
+ */
+static int veyecam2m_check_write(struct veyecam2m *veyecam2m, unsigned int reg)
+{
+	if (!veyecam2m->power_on && veyecam2m_volatile_reg(NULL, reg))
+		return -EBUSY;
+	return 0;
+}
+
+static const struct regmap_config veyecam2m_regmap_config = {
+	.reg_bits = 16,
+	.val_bits = 8,
+	.max_register = VEYECAM2M_REG_BOARD_TYPE,
+	.writeable_reg = veyecam2m_writeable_reg,
+	.volatile_reg = veyecam2m_volatile_reg,
+	.cache_type = REGCACHE_RBTREE,
+};
+
+/* account one operation that started at start, returns its duration in ns */
+static u64 veyecam2m_stat(struct veyecam2m *veyecam2m, enum veyecam2m_stat_op op,
+			  u16 reg, u32 val, u32 len, int ret, ktime_t start)
+{
+	struct veyecam2m_stats *stats = &veyecam2m->stats;
+	struct veyecam2m_op_stat *st = &stats->ops[op];
+	struct veyecam2m_xfer *xfer;
+	ktime_t now = ktime_get();
+	u64 ns = ktime_to_ns(ktime_sub(now, start));
+	u64 us = div_u64(ns, NSEC_PER_USEC);
+	unsigned long flags;
+
+	spin_lock_irqsave(&stats->lock, flags);
+	st->count++;
+	if (ret)
+		st->errors++;
+	st->total_us += us;
+	st->max_us = max(st->max_us, us);
+	st->buckets[min_t(u64, fls64(us), VEYECAM2M_STAT_BUCKETS - 1)]++;
+
+	xfer = &stats->history[stats->head];
+	xfer->time = now;
+	xfer->us = min_t(u64, us, U32_MAX);
+	xfer->op = op;
+	xfer->reg = reg;
+	xfer->val = val;
+	xfer->len = len;
+	xfer->ret = ret;
+	stats->head = (stats->head + 1) % VEYECAM2M_STAT_HISTORY;
+	if (stats->num < VEYECAM2M_STAT_HISTORY)
+		stats->num++;
+	spin_unlock_irqrestore(&stats->lock, flags);
+
+	return ns;
+}
+
+static int veyecam2m_stats_show(struct seq_file *m, void *data)
+{
+	struct veyecam2m *veyecam2m = m->private;
+	struct veyecam2m_stats *stats = &veyecam2m->stats;
+	struct veyecam2m_op_stat *st;
+	struct veyecam2m_xfer *xfer;
+	unsigned int op, i;
+	unsigned long flags;
+	u32 usec;
+	u64 sec;
+
+	spin_lock_irqsave(&stats->lock, flags);
+	for (op = 0; op < VEYECAM2M_STAT_NUM_OPS; op++) {
+		st = &stats->ops[op];
+		if (!st->count)
+			continue;
+		seq_printf(m, "[%s] count %llu errors %llu avg_us %llu max_us %llu\n",
+			   veyecam2m_stat_names[op], st->count, st->errors,
+			   div64_u64(st->total_us, st->count), st->max_us);
+		for (i = 0; i < VEYECAM2M_STAT_BUCKETS; i++) {
+			if (!st->buckets[i])
+				continue;
+			if (i == 0)
+				seq_printf(m, "  %8s us: %llu\n", "0", st->buckets[i]);
+			else if (i == VEYECAM2M_STAT_BUCKETS - 1)
+				seq_printf(m, "  %8lu+ us: %llu\n", 1UL << (i - 1), st->buckets[i]);
+			else
+				seq_printf(m, "  %8lu-%lu us: %llu\n", 1UL << (i - 1),
+					   (1UL << i) - 1, st->buckets[i]);
+		}
+	}
+
+	seq_printf(m, "last %u transactions, oldest first:\n", stats->num);
+	for (i = 0; i < stats->num; i++) {
+		xfer = &stats->history[(stats->head + VEYECAM2M_STAT_HISTORY -
+					stats->num + i) % VEYECAM2M_STAT_HISTORY];
+		sec = div_u64_rem(ktime_to_us(xfer->time), USEC_PER_SEC, &usec);
+		seq_printf(m, "  %llu.%06u %-15s reg 0x%04x val 0x%02x len %u ret %d %u us\n",
+			   sec, usec, veyecam2m_stat_names[xfer->op], xfer->reg, xfer->val,
+			   xfer->len, xfer->ret, xfer->us);
+	}
+	spin_unlock_irqrestore(&stats->lock, flags);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(veyecam2m_stats);
+
 static int veyecam2m_write_reg(struct veyecam2m *veyecam2m, u16 reg, u8 val)
 {
+	struct i2c_client *client = v4l2_get_subdevdata(&veyecam2m->sd);
 	int ret;
-	unsigned char data[3] = { reg >> 8, reg & 0xff, val};
-	
-    struct i2c_client *client = v4l2_get_subdevdata(&veyecam2m->sd);
-	ret = i2c_master_send(client, data, 3);
-	/*
-	 * Writing the wrong number of bytes also needs to be flagged as an
-	 * error. Success needs to produce a 0 return code.
-	 */
-	if (ret == 3) {
-		ret = 0;
-	} else {
+
+	ktime_t start = ktime_get();
+	u64 ns;
+
+	ret = veyecam2m_check_write(veyecam2m, reg);
+	if (!ret)
+		ret = regmap_write(veyecam2m->regmap, reg, val);
+	ns = veyecam2m_stat(veyecam2m, VEYECAM2M_STAT_WRITE_REG, reg, val, 1, ret, start);
+	trace_veyecam2m_write_reg(&client->dev, reg, val, 1, ret, ns);
+	if (ret)
 		dev_dbg(&client->dev, "%s: i2c write error, reg: %x\n",
 				__func__, reg);
-		if (ret >= 0)
-			ret = -EINVAL;
-	}
 
 	return ret;
 }
 
-static int veyecam2m_read_reg(struct veyecam2m *veyecam2m, u16 reg, u8 *val)
+/*
+ * Read len consecutive registers. Uncached registers are fetched with one
+ * transfer, the register address write and the data read joined by a
+ * repeated start, so no other master can get between them.
+ */
+static int veyecam2m_read_regs(struct veyecam2m *veyecam2m, u16 reg, u8 *val,
+			       u16 len)
 {
-	int ret;
-	unsigned char data_w[2] = { reg >> 8, reg & 0xff };
 	struct i2c_client *client = v4l2_get_subdevdata(&veyecam2m->sd);
+	int ret;
 
-	ret = i2c_master_send(client, data_w, 2);
-	/*
-	 * A negative return code, or sending the wrong number of bytes, both
-	 * count as an error.
-	 */
-	if (ret != 2) {
-		dev_dbg(&client->dev, "%s: i2c write error, reg: %x\n",
-			__func__, reg);
-		if (ret >= 0)
-			ret = -EINVAL;
-		return ret;
-	}
+	ktime_t start = ktime_get();
+	u64 ns;
 
-	ret = i2c_master_recv(client, val, 1);
-	/*
-	 * The only return value indicating success is 1. Anything else, even
-	 * a non-negative value, indicates something went wrong.
-	 */
-	if (ret == 1) {
-		ret = 0;
-	} else {
-		dev_dbg(&client->dev, "%s: i2c read error, reg: %x\n",
-				__func__, reg);
-		if (ret >= 0)
-			ret = -EINVAL;
-	}
+	ret = regmap_bulk_read(veyecam2m->regmap, reg, val, len);
+	ns = veyecam2m_stat(veyecam2m, VEYECAM2M_STAT_READ_REG, reg,
+			    ret ? 0 : val[0], len, ret, start);
+	trace_veyecam2m_read_reg(&client->dev, reg, ret ? 0 : val[0], len, ret, ns);
+	if (ret)
+		dev_dbg(&client->dev, "%s: i2c read error, reg: %x len: %u\n",
+			__func__, reg, len);
 
 	return ret;
 }
 
-/* Write a list of registers */
+static int veyecam2m_read_reg(struct veyecam2m *veyecam2m, u16 reg, u8 *val)
+{
+	return veyecam2m_read_regs(veyecam2m, reg, val, 1);
+}
+
+/*
+ * Write a list of registers under one regmap lock. The camera does not
+ * auto increment on writes, so each entry still is its own transfer.
+ */
 static int veyecam2m_write_regs(struct veyecam2m *veyecam2m,
-			     const struct veyecam2m_reg *regs, u32 len)
+			     const struct reg_sequence *regs, u32 len)
 {
 	struct i2c_client *client = v4l2_get_subdevdata(&veyecam2m->sd);
+	ktime_t start = ktime_get();
+	u64 ns;
+	int ret = 0;
+	u32 i;
+
+	if (!len)
+		return 0;
+	for (i = 0; i < len && !ret; i++)
+		ret = veyecam2m_check_write(veyecam2m, regs[i].reg);
+	if (!ret)
+		ret = regmap_multi_reg_write(veyecam2m->regmap, regs, len);
+	ns = veyecam2m_stat(veyecam2m, VEYECAM2M_STAT_WRITE_REGS, regs[0].reg,
+			    regs[0].def, len, ret, start);
+	trace_veyecam2m_write_regs(&client->dev, regs[0].reg, regs[0].def, len, ret, ns);
+	if (ret)
+		dev_err_ratelimited(&client->dev,
+				    "Failed to write reg list at 0x%4.4x. error = %d\n",
+				    regs[0].reg, ret);
+	return ret;
+}
+
+static u64 veyecam2m_pixel_rate(struct veyecam2m *veyecam2m, unsigned int index)
+{
+	/* double data rate, two bits per lane and link clock */
+	return div_u64((u64)veyecam2m->link_freqs[index] * 2 * veyecam2m->num_lanes,
+		       VEYECAM2M_BPP);
+}
+
+/* index of the slowest link frequency that carries the mode */
+static int veyecam2m_find_link(struct veyecam2m *veyecam2m,
+			       const struct veyecam2m_mode *mode)
+{
+	u64 needed = (u64)mode->width * mode->height * mode->max_framerate;
 	unsigned int i;
-	int ret;
 
-	for (i = 0; i < len; i++) {
-		ret = veyecam2m_write_reg(veyecam2m, regs[i].address, regs[i].val);
-		if (ret) {
-			dev_err_ratelimited(&client->dev,
-					    "Failed to write reg 0x%4.4x. error = %d\n",
-					    regs[i].address, ret);
-			return ret;
-		}
+	for (i = 0; i < veyecam2m->num_link_freqs; i++) {
+		if (veyecam2m_pixel_rate(veyecam2m, i) >= needed)
+			return i;
 	}
-	return 0;
+	return -EINVAL;
+}
+
+/* media bus codes the camera can send, indexed by their YUV_SEQ value */
+static const u32 veyecam2m_codes[] = {
+	[VEYECAM2M_YUV_SEQ_UYVY] = MEDIA_BUS_FMT_UYVY8_2X8,
+	[VEYECAM2M_YUV_SEQ_YUYV] = MEDIA_BUS_FMT_YUYV8_2X8,
+};
+
+static int veyecam2m_yuv_seq(u32 code)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(veyecam2m_codes); i++) {
+		if (veyecam2m_codes[i] == code)
+			return i;
+	}
+	return -EINVAL;
 }
 
 static void veyecam2m_set_default_format(struct veyecam2m *veyecam2m)
@@ -260,71 +698,229 @@ static void veyecam2m_set_default_format(struct veyecam2m *veyecam2m)
     fmt->ycbcr_enc = V4L2_MAP_YCBCR_ENC_DEFAULT(fmt->colorspace);
 	fmt->quantization = V4L2_QUANTIZATION_FULL_RANGE;
 	fmt->xfer_func = V4L2_MAP_XFER_FUNC_DEFAULT(fmt->colorspace);
-	fmt->width = supported_modes[0].width;
-	fmt->height = supported_modes[0].height;
+	fmt->width = veyecam2m->modes[0].width;
+	fmt->height = veyecam2m->modes[0].height;
 	fmt->field = V4L2_FIELD_NONE;
 }
 
 
-static int veyecam2m_set_ctrl(struct v4l2_ctrl *ctrl)
+/* the ISP acts on a window command before the window may be reused */
+static void veyecam2m_isp_settle(void)
 {
-    VEYE_TRACE
-    return 0;
-    #if 0
-	struct veyecam2m *veyecam2m =
-		container_of(ctrl->handler, struct veyecam2m, ctrl_handler);
-	//struct i2c_client *client = v4l2_get_subdevdata(&veyecam2m->sd);
-	int ret = 0;
+	usleep_range(VEYECAM2M_ISP_CMD_DELAY_US, VEYECAM2M_ISP_CMD_DELAY_US + 1000);
+}
 
-    if ((ctrl->id == V4L2_CID_PIXEL_RATE) || (ctrl->id == V4L2_CID_LINK_FREQ)){
-		ret = 0;
-    }
+/*
+ * Write a group of ISP parameters. Each one takes a full pass through the
+ * indirect window in one regmap call, followed by the settle time. The
+ * sleep is ours and not a reg_sequence delay, regmap would busy wait it.
+ */
+static int veyecam2m_isp_write(struct veyecam2m *veyecam2m,
+			       const struct veyecam2m_isp_val *vals, u32 num)
+{
+	u32 i;
+	int ret;
 
-	/*
-	 * Applying V4L2 control value only happens
-	 * when power is up for streaming
-	 */
+	if (WARN_ON(num > VEYECAM2M_ISP_MAX_GROUP))
+		return -EINVAL;
+	for (i = 0; i < num; i++) {
+		const struct reg_sequence regs[] = {
+			{ VEYECAM2M_REG_ISP_ADDR_H, vals[i].addr >> 8 },
+			{ VEYECAM2M_REG_ISP_ADDR_L, vals[i].addr & 0xff },
+			{ VEYECAM2M_REG_ISP_WVAL, vals[i].val },
+			{ VEYECAM2M_REG_ISP_CMD, VEYECAM2M_ISP_CMD_WRITE },
+		};
+
+		ret = veyecam2m_write_regs(veyecam2m, regs, ARRAY_SIZE(regs));
+		if (ret)
+			return ret;
+		veyecam2m_isp_settle();
+	}
+	return 0;
+}
 
-/*	switch (ctrl->id) {
-	case V4L2_CID_ANALOGUE_GAIN:
-		ret = veyecam2m_write_reg(veyecam2m, VEYECAM2M_REG_ANALOG_GAIN,
-				       VEYECAM2M_REG_VALUE_08BIT, ctrl->val);
-		break;
-	case V4L2_CID_EXPOSURE:
-		ret = veyecam2m_write_reg(veyecam2m, VEYECAM2M_REG_EXPOSURE,
-				       VEYECAM2M_REG_VALUE_16BIT, ctrl->val);
+static int veyecam2m_isp_read(struct veyecam2m *veyecam2m, u16 addr, u8 *val)
+{
+	const struct reg_sequence regs[] = {
+		{ VEYECAM2M_REG_ISP_ADDR_H, addr >> 8 },
+		{ VEYECAM2M_REG_ISP_ADDR_L, addr & 0xff },
+		{ VEYECAM2M_REG_ISP_CMD, VEYECAM2M_ISP_CMD_READ },
+	};
+	int ret;
+
+	ret = veyecam2m_write_regs(veyecam2m, regs, ARRAY_SIZE(regs));
+	if (ret)
+		return ret;
+	veyecam2m_isp_settle();
+	return veyecam2m_read_reg(veyecam2m, VEYECAM2M_REG_ISP_RVAL, val);
+}
+
+/*
+ * Controls of one cluster land in one register group, so the handler is
+ * only called for the cluster master and writes the group in one go. This
+ * is also all __v4l2_ctrl_handler_setup() does at stream start.
+ */
+static int veyecam2m_apply_ctrl(struct veyecam2m *veyecam2m,
+				struct v4l2_ctrl *ctrl)
+{
+	const struct veyecam2m_raw_ctrl *raw = ctrl->priv;
+	struct veyecam2m_isp_val vals[VEYECAM2M_ISP_MAX_GROUP];
+	u32 num = 0;
+	u32 val;
+
+	switch (ctrl->id) {
+	case V4L2_CID_PIXEL_RATE:
+	case V4L2_CID_LINK_FREQ:
+		return 0;
+	case VEYECAM2M_CID_META_PERIOD:
+		if (veyecam2m->streaming && ctrl->val)
+			mod_delayed_work(system_freezable_wq, &veyecam2m->meta_work,
+					 msecs_to_jiffies(ctrl->val));
+		return 0;
+	case V4L2_CID_EXPOSURE_AUTO:
+		/* the other AE_MODE bits are the camera's saved setup, keep them */
+		if (!veyecam2m->ae_mode_read) {
+			u8 ae_mode;
+			int ret;
+
+			ret = veyecam2m_isp_read(veyecam2m, VEYECAM2M_ISP_AE_MODE, &ae_mode);
+			if (ret)
+				return ret;
+			veyecam2m->ae_mode = ae_mode & ~VEYECAM2M_AE_MODE_MANUAL;
+			veyecam2m->ae_mode_read = true;
+		}
+		if (ctrl->val == V4L2_EXPOSURE_MANUAL) {
+			vals[num++] = (struct veyecam2m_isp_val){ VEYECAM2M_ISP_AE_MODE,
+				veyecam2m->ae_mode | VEYECAM2M_AE_MODE_MANUAL };
+			val = veyecam2m->exposure->val;
+			vals[num++] = (struct veyecam2m_isp_val){ VEYECAM2M_ISP_MSHUTTER_H, val >> 8 };
+			vals[num++] = (struct veyecam2m_isp_val){ VEYECAM2M_ISP_MSHUTTER_L, val & 0xff };
+			val = veyecam2m->gain->val;
+			vals[num++] = (struct veyecam2m_isp_val){ VEYECAM2M_ISP_MGAIN_H, val >> 8 };
+			vals[num++] = (struct veyecam2m_isp_val){ VEYECAM2M_ISP_MGAIN_L, val & 0xff };
+		} else {
+			vals[num++] = (struct veyecam2m_isp_val){ VEYECAM2M_ISP_AE_MODE,
+				veyecam2m->ae_mode };
+		}
 		break;
-	case V4L2_CID_DIGITAL_GAIN:
-		ret = veyecam2m_write_reg(veyecam2m, VEYECAM2M_REG_DIGITAL_GAIN,
-				       VEYECAM2M_REG_VALUE_16BIT, ctrl->val);
+	case V4L2_CID_AUTO_WHITE_BALANCE:
+		if (!ctrl->val) {
+			vals[num++] = (struct veyecam2m_isp_val){ VEYECAM2M_ISP_WB_MODE,
+				VEYECAM2M_WB_MODE_MANUAL };
+			vals[num++] = (struct veyecam2m_isp_val){ VEYECAM2M_ISP_MWB_RGAIN,
+				veyecam2m->red_balance->val };
+			vals[num++] = (struct veyecam2m_isp_val){ VEYECAM2M_ISP_MWB_BGAIN,
+				veyecam2m->blue_balance->val };
+		} else {
+			vals[num++] = (struct veyecam2m_isp_val){ VEYECAM2M_ISP_WB_MODE,
+				VEYECAM2M_WB_MODE_AUTO };
+		}
 		break;
-	case V4L2_CID_HFLIP:
 	case V4L2_CID_VFLIP:
-		ret = veyecam2m_write_reg(veyecam2m, VEYECAM2M_REG_ORIENTATION, 1,
-				       veyecam2m->hflip->val |
-				       veyecam2m->vflip->val << 1);
+		vals[num++] = (struct veyecam2m_isp_val){ VEYECAM2M_ISP_MIRROR,
+			veyecam2m->hflip->val | veyecam2m->vflip->val << 1 };
 		break;
-	case V4L2_CID_VBLANK:
-		ret = veyecam2m_write_reg(veyecam2m, VEYECAM2M_REG_VTS,
-				       VEYECAM2M_REG_VALUE_16BIT,
-				       veyecam2m->mode->height + ctrl->val);
+	case V4L2_CID_BRIGHTNESS:
+		/* PAL and NTSC keep their own brightness, set both */
+		vals[num++] = (struct veyecam2m_isp_val){ VEYECAM2M_ISP_BRIGHTNESS_PAL, ctrl->val };
+		vals[num++] = (struct veyecam2m_isp_val){ VEYECAM2M_ISP_BRIGHTNESS_NTSC, ctrl->val };
+		break;
+	case V4L2_CID_CONTRAST:
+		vals[num++] = (struct veyecam2m_isp_val){ VEYECAM2M_ISP_CONTRAST, ctrl->val };
+		break;
+	case V4L2_CID_SATURATION:
+		vals[num++] = (struct veyecam2m_isp_val){ VEYECAM2M_ISP_SATURATION0, ctrl->val };
+		vals[num++] = (struct veyecam2m_isp_val){ VEYECAM2M_ISP_SATURATION1, ctrl->val };
+		break;
+	case V4L2_CID_SHARPNESS:
+		/* 0 turns sharpening off */
+		vals[num++] = (struct veyecam2m_isp_val){ VEYECAM2M_ISP_SHARPEN_EN, ctrl->val != 0 };
+		if (ctrl->val)
+			vals[num++] = (struct veyecam2m_isp_val){ VEYECAM2M_ISP_SHARPEN_VAL,
+				ctrl->val << 4 | VEYECAM2M_SHARPEN_VAL_LOW };
+		break;
+	case V4L2_CID_POWER_LINE_FREQUENCY:
+		vals[num++] = (struct veyecam2m_isp_val){ VEYECAM2M_ISP_ANTIFLICKER,
+			ctrl->val == V4L2_CID_POWER_LINE_FREQUENCY_DISABLED ?
+			0 : VEYECAM2M_ANTIFLICKER_ON };
 		break;
-
 	default:
-		dev_info(&client->dev,
-			 "ctrl(id:0x%x,val:0x%x) is not handled\n",
-			 ctrl->id, ctrl->val);
-		ret = -EINVAL;
+		if (!raw) {
+			dev_info(veyecam2m->sd.dev,
+				 "ctrl(id:0x%x,val:0x%x) is not handled\n",
+				 ctrl->id, ctrl->val);
+			return -EINVAL;
+		}
+		if (!raw->isp)
+			return veyecam2m_write_reg(veyecam2m, raw->reg, ctrl->val);
+		vals[num++] = (struct veyecam2m_isp_val){ raw->reg, ctrl->val };
 		break;
 	}
-*/
-	//pm_runtime_put(&client->dev);
+
+	return veyecam2m_isp_write(veyecam2m, vals, num);
+}
+
+/* whether the cluster of master was set since probe */
+static bool veyecam2m_ctrl_was_set(struct veyecam2m *veyecam2m,
+				   struct v4l2_ctrl *master)
+{
+	unsigned int i;
+
+	for (i = 0; i < veyecam2m->num_set_ctrls; i++)
+		if (veyecam2m->set_ctrls[i] == master)
+			return true;
+	return false;
+}
+
+static int veyecam2m_set_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct veyecam2m *veyecam2m =
+		container_of(ctrl->handler, struct veyecam2m, ctrl_handler);
+	struct i2c_client *client = v4l2_get_subdevdata(&veyecam2m->sd);
+	unsigned int i = veyecam2m->num_set_ctrls;
+	int ret;
+
+	/*
+	 * The controls start from driver defaults, not from the camera, so
+	 * stream on only restores what was set since probe and leaves the
+	 * camera's saved setup alone otherwise.
+	 */
+	if (!veyecam2m_ctrl_was_set(veyecam2m, ctrl)) {
+		if (veyecam2m->restoring)
+			return 0;
+		if (!WARN_ON(i == ARRAY_SIZE(veyecam2m->set_ctrls)))
+			veyecam2m->set_ctrls[veyecam2m->num_set_ctrls++] = ctrl;
+	}
+
+	/*
+	 * Applying V4L2 control value only happens when the camera is
+	 * powered, a suspended camera gets them at stream on
+	 */
+	if (pm_runtime_get_if_in_use(&client->dev) == 0)
+		return 0;
+
+	ret = veyecam2m_apply_ctrl(veyecam2m, ctrl);
+
+	pm_runtime_put(&client->dev);
 
 	return ret;
-    #endif
+}
+
+static int veyecam2m_g_volatile_ctrl(struct v4l2_ctrl *ctrl)
+{
+	struct veyecam2m *veyecam2m =
+		container_of(ctrl->handler, struct veyecam2m, ctrl_handler);
+
+	switch (ctrl->id) {
+	case VEYECAM2M_CID_META:
+		memcpy(ctrl->p_new.p_u8, &veyecam2m->meta, sizeof(veyecam2m->meta));
+		return 0;
+	}
+	return -EINVAL;
 }
 
 static const struct v4l2_ctrl_ops veyecam2m_ctrl_ops = {
+	.g_volatile_ctrl = veyecam2m_g_volatile_ctrl,
 	.s_ctrl = veyecam2m_set_ctrl,
 };
 
@@ -333,9 +929,9 @@ static int veyecam2m_enum_mbus_code(struct v4l2_subdev *sd,
 				 struct v4l2_subdev_mbus_code_enum *code)
 {
     VEYE_TRACE
-    if (code->index > 0)
-            return -EINVAL;
-     code->code = MEDIA_BUS_FMT_UYVY8_2X8;
+	if (code->index >= ARRAY_SIZE(veyecam2m_codes))
+		return -EINVAL;
+	code->code = veyecam2m_codes[code->index];
 	return 0;
 }
 
@@ -343,17 +939,52 @@ static int veyecam2m_enum_frame_size(struct v4l2_subdev *sd,
 				  struct v4l2_subdev_state *sd_state,
 				  struct v4l2_subdev_frame_size_enum *fse)
 {
+	struct veyecam2m *veyecam2m = to_veyecam2m(sd);
     VEYE_TRACE
-//	if (fse->code != MEDIA_BUS_FMT_UYVY8_2X8)
-//		return -EINVAL;
+	if (veyecam2m_yuv_seq(fse->code) < 0)
+		return -EINVAL;
 
-	if (fse->index >= ARRAY_SIZE(supported_modes))
+	if (fse->index >= veyecam2m->num_modes)
 		return -EINVAL;
     
-	fse->min_width = supported_modes[fse->index].width;
-	fse->max_width = supported_modes[fse->index].width;
-	fse->min_height = supported_modes[fse->index].height;
-	fse->max_height = supported_modes[fse->index].height;
+	fse->min_width = veyecam2m->modes[fse->index].width;
+	fse->max_width = veyecam2m->modes[fse->index].width;
+	fse->min_height = veyecam2m->modes[fse->index].height;
+	fse->max_height = veyecam2m->modes[fse->index].height;
+
+	return 0;
+}
+
+/* each mode runs at its maximum frame rate */
+static int veyecam2m_enum_frame_interval(struct v4l2_subdev *sd,
+				      struct v4l2_subdev_state *sd_state,
+				      struct v4l2_subdev_frame_interval_enum *fie)
+{
+	struct veyecam2m *veyecam2m = to_veyecam2m(sd);
+	unsigned int i, index = 0;
+
+	for (i = 0; i < veyecam2m->num_modes; i++) {
+		if (veyecam2m->modes[i].width != fie->width ||
+		    veyecam2m->modes[i].height != fie->height)
+			continue;
+		if (index++ == fie->index) {
+			fie->interval.numerator = 1;
+			fie->interval.denominator = veyecam2m->modes[i].max_framerate;
+			return 0;
+		}
+	}
+	return -EINVAL;
+}
+
+static int veyecam2m_g_frame_interval(struct v4l2_subdev *sd,
+				   struct v4l2_subdev_frame_interval *fi)
+{
+	struct veyecam2m *veyecam2m = to_veyecam2m(sd);
+
+	mutex_lock(&veyecam2m->mutex);
+	fi->interval.numerator = 1;
+	fi->interval.denominator = veyecam2m->mode->max_framerate;
+	mutex_unlock(&veyecam2m->mutex);
 
 	return 0;
 }
@@ -374,7 +1005,7 @@ static int __veyecam2m_get_pad_format(struct veyecam2m *veyecam2m,
 	} else {
 		fmt->format.width = mode->width;
         fmt->format.height = mode->height;
-        fmt->format.code = MEDIA_BUS_FMT_UYVY8_2X8;
+        fmt->format.code = veyecam2m->fmt.code;
 		fmt->format.field = V4L2_FIELD_NONE;
         fmt->format.ycbcr_enc = V4L2_MAP_YCBCR_ENC_DEFAULT(fmt->format.colorspace);
         fmt->format.quantization = V4L2_QUANTIZATION_FULL_RANGE;
@@ -405,31 +1036,57 @@ static int veyecam2m_set_pad_format(struct v4l2_subdev *sd,
 //    struct i2c_client *client = veyecam2m->i2c_client;
    // struct v4l2_mbus_framefmt *__format;
     const struct veyecam2m_mode *new_mode;
-    int ret = 0,mode,flag=0;
+    int ret = 0, link, seq;
 	const struct veyecam2m_reg_list *reg_list;
     
 	mutex_lock(&veyecam2m->mutex);
 
 	//debug_printk(" %s\n",__func__);
 	
-        for(mode=0;mode<ARRAY_SIZE(supported_modes);mode++) {
-           if((fmt->format.width==supported_modes[mode].width)&&
-                   (fmt->format.height==supported_modes[mode].height)){
-                     new_mode = &supported_modes[mode];
-                     flag=1;
-                     break;
-            }
-         }
-         if(flag==0){
-           ret = -EINVAL;
-           goto error;
-         }
-
-/*	fmt->format.code = MEDIA_BUS_FMT_UYVY8_2X8;
+	/* the closest mode the camera reported, in the byte order asked for */
+	new_mode = v4l2_find_nearest_size(veyecam2m->modes, veyecam2m->num_modes,
+					  width, height,
+					  fmt->format.width, fmt->format.height);
+	seq = veyecam2m_yuv_seq(fmt->format.code);
+	if (seq < 0)
+		seq = veyecam2m_yuv_seq(veyecam2m->fmt.code);
+	fmt->format = veyecam2m->fmt;
 	fmt->format.width = new_mode->width;
 	fmt->format.height = new_mode->height;
-	fmt->format.field = V4L2_FIELD_NONE;*/
+	fmt->format.code = veyecam2m_codes[seq];
+
+	link = veyecam2m_find_link(veyecam2m, new_mode);
+	if (link < 0) {
+		ret = link;
+		goto error;
+	}
+
+	if (fmt->which == V4L2_SUBDEV_FORMAT_TRY) {
+#ifdef CONFIG_VIDEO_V4L2_SUBDEV_API
+		*v4l2_subdev_get_try_format(sd, sd_state, fmt->pad) = fmt->format;
+#endif
+		goto error;
+	}
+
+	if (veyecam2m->streaming && (new_mode != veyecam2m->mode ||
+				     fmt->format.code != veyecam2m->fmt.code)) {
+		ret = -EBUSY;
+		goto error;
+	}
+	if (fmt->format.code != veyecam2m->fmt.code) {
+		/* cached while the camera is suspended, synced at power on */
+		ret = veyecam2m_write_reg(veyecam2m, VEYECAM2M_REG_YUV_SEQ, seq);
+		if (ret)
+			goto error;
+		veyecam2m->fmt.code = fmt->format.code;
+	}
     veyecam2m->mode = new_mode;
+	veyecam2m->fmt.width = new_mode->width;
+	veyecam2m->fmt.height = new_mode->height;
+	veyecam2m->link_freq_index = link;
+	__v4l2_ctrl_s_ctrl(veyecam2m->link_freq, link);
+	__v4l2_ctrl_s_ctrl_int64(veyecam2m->pixel_rate,
+				 veyecam2m_pixel_rate(veyecam2m, link));
 	/* Apply default values of current mode */
 	reg_list = &veyecam2m->mode->reg_list;
 	ret = veyecam2m_write_regs(veyecam2m, reg_list->regs, reg_list->num_of_regs);
@@ -445,12 +1102,14 @@ error:
 	return ret;
 }
 
-static int veyecam2m_start_streaming(struct veyecam2m *veyecam2m)
+static int __veyecam2m_start_streaming(struct veyecam2m *veyecam2m)
 {
 	struct i2c_client *client = v4l2_get_subdevdata(&veyecam2m->sd);
 	const struct veyecam2m_reg_list *reg_list;
 	int ret;
     VEYE_TRACE
+	/* runtime resume already restored the cached registers */
+
 	/* Apply default values of current mode */
 	reg_list = &veyecam2m->mode->reg_list;
 	ret = veyecam2m_write_regs(veyecam2m, reg_list->regs, reg_list->num_of_regs);
@@ -460,29 +1119,125 @@ static int veyecam2m_start_streaming(struct veyecam2m *veyecam2m)
 	}
 
 	/* Apply customized values from user */
+	veyecam2m->restoring = true;
 	ret =  __v4l2_ctrl_handler_setup(veyecam2m->sd.ctrl_handler);
+	veyecam2m->restoring = false;
 	if (ret)
 		return ret;
 
 	/* set stream on register */
-	return veyecam2m_write_reg(veyecam2m, VEYECAM_STREAMING_ON, VEYECAM_MODE_STREAMING);
+	return veyecam2m_write_reg(veyecam2m, VEYECAM2M_REG_STREAM_ON, VEYECAM_MODE_STREAMING);
+}
+
+static int veyecam2m_start_streaming(struct veyecam2m *veyecam2m)
+{
+	struct i2c_client *client = v4l2_get_subdevdata(&veyecam2m->sd);
+	ktime_t start = ktime_get();
+	u64 ns;
+	int ret;
+
+	ret = __veyecam2m_start_streaming(veyecam2m);
+	ns = veyecam2m_stat(veyecam2m, VEYECAM2M_STAT_START_STREAMING, 0, 0, 0, ret, start);
+	trace_veyecam2m_start_streaming(&client->dev, ret, ns);
+	if (ret)
+		return ret;
+
+	veyecam2m->meta.sequence = 0;
+	if (veyecam2m->meta_period->val)
+		queue_delayed_work(system_freezable_wq, &veyecam2m->meta_work,
+				   msecs_to_jiffies(veyecam2m->meta_period->val));
+
+	return 0;
 }
 
 static void veyecam2m_stop_streaming(struct veyecam2m *veyecam2m)
 {
 	struct i2c_client *client = v4l2_get_subdevdata(&veyecam2m->sd);
+	ktime_t start = ktime_get();
+	u64 ns;
 	int ret;
     VEYE_TRACE
+	/* a snapshot already running sees streaming cleared and stops */
+	cancel_delayed_work(&veyecam2m->meta_work);
+
 	/* set stream off register */
-	ret = veyecam2m_write_reg(veyecam2m, VEYECAM_STREAMING_ON, VEYECAM_MODE_STANDBY);
+	ret = veyecam2m_write_reg(veyecam2m, VEYECAM2M_REG_STREAM_ON, VEYECAM_MODE_STANDBY);
 	if (ret)
 		dev_err(&client->dev, "%s failed to set stream\n", __func__);
+	ns = veyecam2m_stat(veyecam2m, VEYECAM2M_STAT_STOP_STREAMING, 0, 0, 0, ret, start);
+	trace_veyecam2m_stop_streaming(&client->dev, ret, ns);
+}
+
+/*
+ * Read back exposure, gain and white balance gains every META_PERIOD ms
+ * while streaming and hand them out as a V4L2 event. Each value goes
+ * through the ISP window, a snapshot takes about 60 ms of bus time, so the
+ * period runs from the end of one snapshot to the start of the next.
+ */
+static void veyecam2m_meta_work(struct work_struct *work)
+{
+	struct veyecam2m *veyecam2m = container_of(to_delayed_work(work),
+						   struct veyecam2m, meta_work);
+	struct veyecam2m_meta meta = { 0 };
+	struct v4l2_event ev = {
+		.type = VEYECAM2M_EVENT_META,
+	};
+	static const u16 regs[] = {
+		VEYECAM2M_ISP_AWB_RGAIN, VEYECAM2M_ISP_AWB_BGAIN,
+	};
+	ktime_t now = ktime_get();
+	u8 vals[ARRAY_SIZE(regs)];
+	unsigned int i;
+	int ret = 0;
+
+	/*
+	 * Take the lock per window command, a control set meanwhile waits
+	 * for one settle time and not for the whole snapshot
+	 */
+	for (i = 0; i < ARRAY_SIZE(regs) && !ret; i++) {
+		mutex_lock(&veyecam2m->mutex);
+		ret = veyecam2m->streaming ?
+			veyecam2m_isp_read(veyecam2m, regs[i], &vals[i]) : -ENODATA;
+		mutex_unlock(&veyecam2m->mutex);
+	}
+
+	mutex_lock(&veyecam2m->mutex);
+	if (!veyecam2m->streaming)
+		goto out;
+
+	if (!ret) {
+		meta.timestamp = ktime_to_ns(now);
+		meta.sequence = veyecam2m->meta.sequence + 1;
+		meta.exposure_auto = veyecam2m->exposure_auto->cur.val;
+		meta.wb_auto = veyecam2m->wb_auto->cur.val;
+		/* a manual exposure the camera had saved is not known here */
+		if (meta.exposure_auto == V4L2_EXPOSURE_MANUAL &&
+		    veyecam2m_ctrl_was_set(veyecam2m, veyecam2m->exposure_auto)) {
+			meta.flags |= VEYECAM2M_META_EXPOSURE;
+			meta.exposure = veyecam2m->exposure->cur.val;
+			meta.gain = veyecam2m->gain->cur.val;
+		}
+		meta.red_gain = vals[0];
+		meta.blue_gain = vals[1];
+		veyecam2m->meta = meta;
+
+		memcpy(ev.u.data, &meta, sizeof(meta));
+		v4l2_subdev_notify_event(&veyecam2m->sd, &ev);
+	} else {
+		dev_dbg(veyecam2m->sd.dev, "metadata snapshot failed (%d)\n", ret);
+	}
+
+	if (veyecam2m->meta_period->val)
+		queue_delayed_work(system_freezable_wq, &veyecam2m->meta_work,
+				   msecs_to_jiffies(veyecam2m->meta_period->val));
+out:
+	mutex_unlock(&veyecam2m->mutex);
 }
 
 static int veyecam2m_set_stream(struct v4l2_subdev *sd, int enable)
 {
 	struct veyecam2m *veyecam2m = to_veyecam2m(sd);
-	//struct i2c_client *client = v4l2_get_subdevdata(sd);
+	struct i2c_client *client = v4l2_get_subdevdata(sd);
 	int ret = 0;
     debug_printk("start streaming %d\n", enable );
 	mutex_lock(&veyecam2m->mutex);
@@ -491,20 +1246,30 @@ static int veyecam2m_set_stream(struct v4l2_subdev *sd, int enable)
 		return 0;
 	}
 	if (enable) {
+		ret = pm_runtime_get_sync(&client->dev);
+		if (ret < 0) {
+			pm_runtime_put_noidle(&client->dev);
+			goto err_unlock;
+		}
+
 		/*
 		 * Apply default & customized values
 		 * and then start streaming.
 		 */
 		ret = veyecam2m_start_streaming(veyecam2m);
 		if (ret)
-			goto err_unlock;
+			goto err_rpm_put;
 	} else {
 		veyecam2m_stop_streaming(veyecam2m);
+		pm_runtime_mark_last_busy(&client->dev);
+		pm_runtime_put_autosuspend(&client->dev);
 	}
 	veyecam2m->streaming = enable;
 	mutex_unlock(&veyecam2m->mutex);
 
 	return ret;
+err_rpm_put:
+	pm_runtime_put(&client->dev);
 err_unlock:
 	mutex_unlock(&veyecam2m->mutex);
 
@@ -512,7 +1277,7 @@ err_unlock:
 }
 
 /* Power/clock management functions */
-static int veyecam2m_power_on(struct veyecam2m *veyecam2m)
+static int __veyecam2m_power_on(struct veyecam2m *veyecam2m)
 {
 	int ret;
     debug_printk("veyecam2m_power_on power on \n" );
@@ -537,6 +1302,8 @@ static int veyecam2m_power_on(struct veyecam2m *veyecam2m)
 	gpiod_set_value_cansleep(veyecam2m->reset_gpio, 1);
 	usleep_range(VEYECAM2M_XCLR_MIN_DELAY_US,
 		     VEYECAM2M_XCLR_MIN_DELAY_US + VEYECAM2M_XCLR_DELAY_RANGE_US);
+	regcache_cache_only(veyecam2m->regmap, false);
+	veyecam2m->power_on = true;
 
 	return 0;
 
@@ -546,34 +1313,133 @@ static int veyecam2m_power_on(struct veyecam2m *veyecam2m)
 	return ret;*/
 }
 
+static int veyecam2m_power_on(struct veyecam2m *veyecam2m)
+{
+	struct i2c_client *client = v4l2_get_subdevdata(&veyecam2m->sd);
+	ktime_t start = ktime_get();
+	u64 ns;
+	int ret;
+
+	ret = __veyecam2m_power_on(veyecam2m);
+	ns = veyecam2m_stat(veyecam2m, VEYECAM2M_STAT_POWER_ON, 0, 0, 0, ret, start);
+	trace_veyecam2m_power_on(&client->dev, ret, ns);
+
+	return ret;
+}
+
 static int veyecam2m_power_off(struct veyecam2m *veyecam2m)
 {
+	struct i2c_client *client = v4l2_get_subdevdata(&veyecam2m->sd);
+	ktime_t start = ktime_get();
+	u64 ns;
 
+	/* a failed probe already powered the camera down */
+	if (!veyecam2m->power_on)
+		return 0;
     debug_printk("veyecam2m_power_off power off \n" );
 	gpiod_set_value_cansleep(veyecam2m->reset_gpio, 0);
+	/* writes until the next power on only go to the cache */
+	regcache_cache_only(veyecam2m->regmap, true);
+	regcache_mark_dirty(veyecam2m->regmap);
+	veyecam2m->power_on = false;
     #if REGULATOR
 	regulator_bulk_disable(VEYECAM2M_NUM_SUPPLIES, veyecam2m->supplies);
     #endif
 	clk_disable_unprepare(veyecam2m->xclk);
+	ns = veyecam2m_stat(veyecam2m, VEYECAM2M_STAT_POWER_OFF, 0, 0, 0, 0, start);
+	trace_veyecam2m_power_off(&client->dev, 0, ns);
+
+	return 0;
+}
+
+
+/* poll DEVICE_ID until the camera has booted */
+static int veyecam2m_wait_boot(struct veyecam2m *veyecam2m)
+{
+	ktime_t timeout = ktime_add_ms(ktime_get(), VEYECAM2M_BOOT_TIMEOUT_MS);
+	u8 device_id;
+
+	while (veyecam2m_read_reg(veyecam2m, VEYECAM2M_REG_DEVICE_ID, &device_id)) {
+		if (ktime_after(ktime_get(), timeout))
+			return -ETIMEDOUT;
+		usleep_range(VEYECAM2M_BOOT_POLL_MS * 1000,
+			     VEYECAM2M_BOOT_POLL_MS * 1000 + 1000);
+	}
+	return 0;
+}
+
+/*
+ * Resume restores the camera from the register cache instead of running
+ * the probe sequence again, ISP parameters follow at stream on.
+ */
+static int __maybe_unused veyecam2m_runtime_resume(struct device *dev)
+{
+	struct i2c_client *client = to_i2c_client(dev);
+	struct v4l2_subdev *sd = i2c_get_clientdata(client);
+	struct veyecam2m *veyecam2m = to_veyecam2m(sd);
+	int ret;
+
+	ret = veyecam2m_power_on(veyecam2m);
+	if (ret)
+		return ret;
+
+	ret = veyecam2m_wait_boot(veyecam2m);
+	if (ret) {
+		dev_err(dev, "%s: camera did not answer after power on\n", __func__);
+		goto error;
+	}
+
+	ret = regcache_sync(veyecam2m->regmap);
+	if (ret) {
+		dev_err(dev, "%s: failed to restore registers\n", __func__);
+		goto error;
+	}
 
 	return 0;
+
+error:
+	veyecam2m_power_off(veyecam2m);
+
+	return ret;
 }
 
+static int __maybe_unused veyecam2m_runtime_suspend(struct device *dev)
+{
+	struct i2c_client *client = to_i2c_client(dev);
+	struct v4l2_subdev *sd = i2c_get_clientdata(client);
+
+	return veyecam2m_power_off(to_veyecam2m(sd));
+}
 
+/* legacy power op for bridges that still call it, backed by runtime PM */
 static int veyecam2m_s_power(struct v4l2_subdev *sd, int on)
 {
 	struct veyecam2m *veyecam2m = to_veyecam2m(sd);
+	struct i2c_client *client = v4l2_get_subdevdata(sd);
 	int ret = 0;
-    
-    if (on) {
-        ret = veyecam2m_power_on(veyecam2m);
-        usleep_range(500, 1000);
-    } else {
-        ret = veyecam2m_power_off(veyecam2m);
-    }
+
+	mutex_lock(&veyecam2m->mutex);
+	if (veyecam2m->powered == !!on)
+		goto out;
+
+	if (on) {
+		ret = pm_runtime_get_sync(&client->dev);
+		if (ret < 0) {
+			pm_runtime_put_noidle(&client->dev);
+			goto out;
+		}
+		ret = 0;
+	} else {
+		pm_runtime_mark_last_busy(&client->dev);
+		pm_runtime_put_autosuspend(&client->dev);
+	}
+	veyecam2m->powered = on;
+out:
+	mutex_unlock(&veyecam2m->mutex);
     debug_printk("veyecam2m_s_power power %d return %d\n",on,ret );
 	return ret;
 }
+
 static int __maybe_unused veyecam2m_suspend(struct device *dev)
 {
 	struct i2c_client *client = to_i2c_client(dev);
@@ -629,24 +1495,20 @@ static int veyecam2m_read_model(struct veyecam2m *veyecam2m)
 {
     struct i2c_client *client = v4l2_get_subdevdata(&veyecam2m->sd);
 	int ret;
+    /* SENSOR_ID_L up to BOARD_TYPE in one burst */
+    u8 id[VEYECAM2M_REG_BOARD_TYPE - VEYECAM2M_REG_SENSOR_ID_L + 1];
     u8 snr_l;
     u8 snr_h;
     u8 board_no;
-    ret = veyecam2m_read_reg(veyecam2m, SENSOR_TYPR_ADDR_L, &snr_l);
-	if (ret) {
-		dev_err(&client->dev, "probe failed \n");
-		return -ENODEV;
-	}
-    ret = veyecam2m_read_reg(veyecam2m, SENSOR_TYPR_ADDR_H, &snr_h);
-	if (ret) {
-		dev_err(&client->dev, "probe failed \n");
-		return -ENODEV;
-	}
-    ret = veyecam2m_read_reg(veyecam2m, BOARD_TYPR_ADDR, &board_no);
+    ret = veyecam2m_read_regs(veyecam2m, VEYECAM2M_REG_SENSOR_ID_L, id, sizeof(id));
 	if (ret) {
 		dev_err(&client->dev, "probe failed \n");
 		return -ENODEV;
 	}
+    snr_l = id[0];
+    snr_h = id[VEYECAM2M_REG_SENSOR_ID_H - VEYECAM2M_REG_SENSOR_ID_L];
+    veyecam2m->sensor_id = snr_l << 8 | snr_h;
+    board_no = id[VEYECAM2M_REG_BOARD_TYPE - VEYECAM2M_REG_SENSOR_ID_L];
     if(snr_l == 0x03 && snr_h == 0x27){
         dev_err(&client->dev, "sensor is IMX327\n");
     }
@@ -673,7 +1535,7 @@ static int veyecam2m_identify_module(struct veyecam2m *veyecam2m)
     int err;
     u8 device_id;
     VEYE_TRACE
-	ret = veyecam2m_read_reg(veyecam2m, VEYECAM2M_MODEL_ID_ADDR, &device_id);
+	ret = veyecam2m_read_reg(veyecam2m, VEYECAM2M_REG_DEVICE_ID, &device_id);
 	if (ret) {
 		dev_err(&client->dev, "probe failed \n");
 		return -ENODEV;
@@ -704,14 +1566,23 @@ static const struct media_entity_operations veyecam2m_subdev_entity_ops = {
 };
 
 
+static int veyecam2m_subscribe_event(struct v4l2_subdev *sd, struct v4l2_fh *fh,
+				     struct v4l2_event_subscription *sub)
+{
+	if (sub->type == VEYECAM2M_EVENT_META)
+		return v4l2_event_subscribe(fh, sub, VEYECAM2M_META_EVENTS, NULL);
+	return v4l2_ctrl_subdev_subscribe_event(sd, fh, sub);
+}
+
 static const struct v4l2_subdev_core_ops veyecam2m_core_ops = {
-	//.subscribe_event = v4l2_ctrl_subdev_subscribe_event,
-	//.unsubscribe_event = v4l2_event_subdev_unsubscribe,
+	.subscribe_event = veyecam2m_subscribe_event,
+	.unsubscribe_event = v4l2_event_subdev_unsubscribe,
     .s_power = veyecam2m_s_power,
 };
 
 static const struct v4l2_subdev_video_ops veyecam2m_video_ops = {
 	.s_stream = veyecam2m_set_stream,
+	.g_frame_interval = veyecam2m_g_frame_interval,
 };
 
 static const struct v4l2_subdev_pad_ops veyecam2m_pad_ops = {
@@ -721,6 +1592,7 @@ static const struct v4l2_subdev_pad_ops veyecam2m_pad_ops = {
     //?
 	//.get_selection = veyecam2m_get_selection,
 	.enum_frame_size = veyecam2m_enum_frame_size,
+	.enum_frame_interval = veyecam2m_enum_frame_interval,
 };
 
 static const struct v4l2_subdev_ops veyecam2m_subdev_ops = {
@@ -733,6 +1605,28 @@ static const struct v4l2_subdev_internal_ops veyecam2m_internal_ops = {
 	.open = veyecam2m_open,
 };*/
 
+/* latest metadata snapshot */
+static const struct v4l2_ctrl_config veyecam2m_meta_ctrl = {
+	.ops = &veyecam2m_ctrl_ops,
+	.id = VEYECAM2M_CID_META,
+	.name = "Frame Metadata",
+	.type = V4L2_CTRL_TYPE_U8,
+	.flags = V4L2_CTRL_FLAG_READ_ONLY | V4L2_CTRL_FLAG_VOLATILE,
+	.max = 0xff,
+	.step = 1,
+	.dims = { sizeof(struct veyecam2m_meta) },
+};
+
+/* how often to take a snapshot while streaming, 0 is off */
+static const struct v4l2_ctrl_config veyecam2m_meta_period_ctrl = {
+	.ops = &veyecam2m_ctrl_ops,
+	.id = VEYECAM2M_CID_META_PERIOD,
+	.name = "Metadata Period ms",
+	.type = V4L2_CTRL_TYPE_INTEGER,
+	.max = VEYECAM2M_META_PERIOD_MAX_MS,
+	.step = 1,
+};
+
 /* Initialize control handlers */
 static int veyecam2m_init_controls(struct veyecam2m *veyecam2m)
 {
@@ -741,11 +1635,13 @@ static int veyecam2m_init_controls(struct veyecam2m *veyecam2m)
 	//unsigned int height = veyecam2m->mode->height;
 	//struct v4l2_fwnode_device_properties props;
 	//int exposure_max, exposure_def, hblank;
+	u32 gain_max;
+	unsigned int i;
 	int  ret;
     VEYE_TRACE
 	ctrl_hdlr = &veyecam2m->ctrl_handler;
     //v4l2 number
-	ret = v4l2_ctrl_handler_init(ctrl_hdlr, 1);
+	ret = v4l2_ctrl_handler_init(ctrl_hdlr, VEYECAM2M_NUM_CTRLS);
 	if (ret)
 		return ret;
 
@@ -755,68 +1651,89 @@ static int veyecam2m_init_controls(struct veyecam2m *veyecam2m)
 	/* By default, PIXEL_RATE is read only */
 	veyecam2m->pixel_rate = v4l2_ctrl_new_std(ctrl_hdlr, &veyecam2m_ctrl_ops,
 					       V4L2_CID_PIXEL_RATE,
-					       VEYECAM2M_PIXEL_RATE,
-					       VEYECAM2M_PIXEL_RATE, 1,
-					       VEYECAM2M_PIXEL_RATE);
-#if 0
-	/* Initial vblank/hblank/exposure parameters based on current mode */
-	veyecam2m->vblank = v4l2_ctrl_new_std(ctrl_hdlr, &veyecam2m_ctrl_ops,
-					   V4L2_CID_VBLANK, VEYECAM2M_VBLANK_MIN,
-					   VEYECAM2M_VTS_MAX - height, 1,
-					   veyecam2m->mode->vts_def - height);
-	hblank = VEYECAM2M_PPL_DEFAULT - veyecam2m->mode->width;
-	veyecam2m->hblank = v4l2_ctrl_new_std(ctrl_hdlr, &veyecam2m_ctrl_ops,
-					   V4L2_CID_HBLANK, hblank, hblank,
-					   1, hblank);
-	if (veyecam2m->hblank)
-		veyecam2m->hblank->flags |= V4L2_CTRL_FLAG_READ_ONLY;
-	exposure_max = veyecam2m->mode->vts_def - 4;
-	exposure_def = (exposure_max < VEYECAM2M_EXPOSURE_DEFAULT) ?
-		exposure_max : VEYECAM2M_EXPOSURE_DEFAULT;
-	veyecam2m->exposure = v4l2_ctrl_new_std(ctrl_hdlr, &veyecam2m_ctrl_ops,
-					     V4L2_CID_EXPOSURE,
-					     VEYECAM2M_EXPOSURE_MIN, exposure_max,
-					     VEYECAM2M_EXPOSURE_STEP,
-					     exposure_def);
-
-	v4l2_ctrl_new_std(ctrl_hdlr, &veyecam2m_ctrl_ops, V4L2_CID_ANALOGUE_GAIN,
-			  VEYECAM2M_ANA_GAIN_MIN, VEYECAM2M_ANA_GAIN_MAX,
-			  VEYECAM2M_ANA_GAIN_STEP, VEYECAM2M_ANA_GAIN_DEFAULT);
+					       veyecam2m_pixel_rate(veyecam2m, 0),
+					       veyecam2m_pixel_rate(veyecam2m,
+						       veyecam2m->num_link_freqs - 1), 1,
+					       veyecam2m_pixel_rate(veyecam2m,
+						       veyecam2m->link_freq_index));
+	veyecam2m->link_freq = v4l2_ctrl_new_int_menu(ctrl_hdlr, &veyecam2m_ctrl_ops,
+						      V4L2_CID_LINK_FREQ,
+						      veyecam2m->num_link_freqs - 1,
+						      veyecam2m->link_freq_index,
+						      veyecam2m->link_freqs);
+	if (veyecam2m->link_freq)
+		veyecam2m->link_freq->flags |= V4L2_CTRL_FLAG_READ_ONLY;
 
-	v4l2_ctrl_new_std(ctrl_hdlr, &veyecam2m_ctrl_ops, V4L2_CID_DIGITAL_GAIN,
-			  VEYECAM2M_DGTL_GAIN_MIN, VEYECAM2M_DGTL_GAIN_MAX,
-			  VEYECAM2M_DGTL_GAIN_STEP, VEYECAM2M_DGTL_GAIN_DEFAULT);
+	/*
+	 * Reading every ISP parameter back costs a window command each, so
+	 * the controls start from driver defaults and stream on only applies
+	 * the ones set since probe, see veyecam2m_set_ctrl().
+	 */
+	veyecam2m->exposure_auto = v4l2_ctrl_new_std_menu(ctrl_hdlr, &veyecam2m_ctrl_ops,
+				V4L2_CID_EXPOSURE_AUTO, V4L2_EXPOSURE_MANUAL,
+				~(BIT(V4L2_EXPOSURE_AUTO) | BIT(V4L2_EXPOSURE_MANUAL)),
+				V4L2_EXPOSURE_AUTO);
+	veyecam2m->exposure = v4l2_ctrl_new_std(ctrl_hdlr, &veyecam2m_ctrl_ops,
+				V4L2_CID_EXPOSURE, 1, VEYECAM2M_MSHUTTER_MAX, 1,
+				VEYECAM2M_MSHUTTER_DEFAULT);
+	gain_max = veyecam2m->sensor_id == VEYECAM2M_SENSOR_IMX385 ?
+		VEYECAM2M_MGAIN_MAX_IMX385 : VEYECAM2M_MGAIN_MAX;
+	veyecam2m->gain = v4l2_ctrl_new_std(ctrl_hdlr, &veyecam2m_ctrl_ops,
+				V4L2_CID_GAIN, 0, gain_max, 1, 0);
+
+	veyecam2m->wb_auto = v4l2_ctrl_new_std(ctrl_hdlr, &veyecam2m_ctrl_ops,
+				V4L2_CID_AUTO_WHITE_BALANCE, 0, 1, 1, 1);
+	veyecam2m->red_balance = v4l2_ctrl_new_std(ctrl_hdlr, &veyecam2m_ctrl_ops,
+				V4L2_CID_RED_BALANCE, 0, 0xff, 1, 0x80);
+	veyecam2m->blue_balance = v4l2_ctrl_new_std(ctrl_hdlr, &veyecam2m_ctrl_ops,
+				V4L2_CID_BLUE_BALANCE, 0, 0xff, 1, 0x80);
 
+	veyecam2m->vflip = v4l2_ctrl_new_std(ctrl_hdlr, &veyecam2m_ctrl_ops,
+					  V4L2_CID_VFLIP, 0, 1, 1, 0);
 	veyecam2m->hflip = v4l2_ctrl_new_std(ctrl_hdlr, &veyecam2m_ctrl_ops,
 					  V4L2_CID_HFLIP, 0, 1, 1, 0);
-	if (veyecam2m->hflip)
-		veyecam2m->hflip->flags |= V4L2_CTRL_FLAG_MODIFY_LAYOUT;
 
-	veyecam2m->vflip = v4l2_ctrl_new_std(ctrl_hdlr, &veyecam2m_ctrl_ops,
-					  V4L2_CID_VFLIP, 0, 1, 1, 0);
-	if (veyecam2m->vflip)
-		veyecam2m->vflip->flags |= V4L2_CTRL_FLAG_MODIFY_LAYOUT;
-
-	v4l2_ctrl_new_std_menu_items(ctrl_hdlr, &veyecam2m_ctrl_ops,
-				     V4L2_CID_TEST_PATTERN,
-				     ARRAY_SIZE(veyecam2m_test_pattern_menu) - 1,
-				     0, 0, veyecam2m_test_pattern_menu);
-	for (i = 0; i < 4; i++) {
-		/*
-		 * The assumption is that
-		 * V4L2_CID_TEST_PATTERN_GREENR == V4L2_CID_TEST_PATTERN_RED + 1
-		 * V4L2_CID_TEST_PATTERN_BLUE   == V4L2_CID_TEST_PATTERN_RED + 2
-		 * V4L2_CID_TEST_PATTERN_GREENB == V4L2_CID_TEST_PATTERN_RED + 3
-		 */
-		v4l2_ctrl_new_std(ctrl_hdlr, &veyecam2m_ctrl_ops,
-				  V4L2_CID_TEST_PATTERN_RED + i,
-				  VEYECAM2M_TESTP_COLOUR_MIN,
-				  VEYECAM2M_TESTP_COLOUR_MAX,
-				  VEYECAM2M_TESTP_COLOUR_STEP,
-				  VEYECAM2M_TESTP_COLOUR_MAX);
-		/* The "Solid color" pattern is white by default */
+	v4l2_ctrl_new_std(ctrl_hdlr, &veyecam2m_ctrl_ops, V4L2_CID_BRIGHTNESS, 0, 0xff, 1, 0x80);
+	v4l2_ctrl_new_std(ctrl_hdlr, &veyecam2m_ctrl_ops, V4L2_CID_CONTRAST, 0, 0xff, 1, 0x80);
+	v4l2_ctrl_new_std(ctrl_hdlr, &veyecam2m_ctrl_ops, V4L2_CID_SATURATION, 0, 0xff, 1, 0x80);
+	v4l2_ctrl_new_std(ctrl_hdlr, &veyecam2m_ctrl_ops, V4L2_CID_SHARPNESS, 0, 0xf, 1, 0);
+	v4l2_ctrl_new_std_menu(ctrl_hdlr, &veyecam2m_ctrl_ops, V4L2_CID_POWER_LINE_FREQUENCY,
+			       V4L2_CID_POWER_LINE_FREQUENCY_AUTO,
+			       BIT(V4L2_CID_POWER_LINE_FREQUENCY_50HZ) |
+			       BIT(V4L2_CID_POWER_LINE_FREQUENCY_60HZ),
+			       V4L2_CID_POWER_LINE_FREQUENCY_DISABLED);
+
+	for (i = 0; i < ARRAY_SIZE(veyecam2m_raw_ctrls); i++) {
+		struct v4l2_ctrl_config cfg = {
+			.ops = &veyecam2m_ctrl_ops,
+			.id = veyecam2m_raw_ctrls[i].id,
+			.name = veyecam2m_raw_ctrls[i].name,
+			.type = V4L2_CTRL_TYPE_INTEGER,
+			.max = 0xff,
+			.step = 1,
+		};
+		struct v4l2_ctrl *ctrl;
+		u8 reg_val = 0;
+
+		/* plain registers cost one read and land in the regmap cache */
+		if (!veyecam2m_raw_ctrls[i].isp &&
+		    !veyecam2m_read_reg(veyecam2m, veyecam2m_raw_ctrls[i].reg, &reg_val))
+			cfg.def = reg_val;
+		ctrl = v4l2_ctrl_new_custom(ctrl_hdlr, &cfg, NULL);
+		if (ctrl)
+			ctrl->priv = (void *)&veyecam2m_raw_ctrls[i];
+	}
+
+	v4l2_ctrl_new_custom(ctrl_hdlr, &veyecam2m_meta_ctrl, NULL);
+	veyecam2m->meta_period = v4l2_ctrl_new_custom(ctrl_hdlr,
+						      &veyecam2m_meta_period_ctrl, NULL);
+
+	if (!ctrl_hdlr->error) {
+		/* manual exposure and white balance values only count when not auto */
+		v4l2_ctrl_auto_cluster(3, &veyecam2m->exposure_auto, V4L2_EXPOSURE_MANUAL, false);
+		v4l2_ctrl_auto_cluster(3, &veyecam2m->wb_auto, 0, false);
+		v4l2_ctrl_cluster(2, &veyecam2m->vflip);
 	}
-#endif
 	if (ctrl_hdlr->error) {
 		ret = ctrl_hdlr->error;
 		dev_err(&client->dev, "%s control init failed (%d)\n",
@@ -850,13 +1767,19 @@ static void veyecam2m_free_controls(struct veyecam2m *veyecam2m)
 	mutex_destroy(&veyecam2m->mutex);
 }
 
-static int veyecam2m_check_hwcfg(struct device *dev)
+/*
+ * Take the lane count and link frequencies from the DT, keeping only what
+ * the camera can drive. Without a link-frequencies property, or when it
+ * lists none the camera has, every frequency the camera has for that
+ * lane count is used, as the driver did before it read the property.
+ */
+static int veyecam2m_check_hwcfg(struct veyecam2m *veyecam2m, struct device *dev)
 {
 	struct fwnode_handle *endpoint;
 	struct v4l2_fwnode_endpoint ep_cfg = {
 		.bus_type = V4L2_MBUS_CSI2_DPHY
 	};
-    
+	unsigned int i, j, lanes, dt_freqs = 0;
 	int ret = -EINVAL;
     VEYE_TRACE
 	endpoint = fwnode_graph_get_next_endpoint(dev_fwnode(dev), NULL);
@@ -871,24 +1794,47 @@ static int veyecam2m_check_hwcfg(struct device *dev)
 	}
 
 	/* Check the number of MIPI CSI2 data lanes */
-	if (ep_cfg.bus.mipi_csi2.num_data_lanes != 2) {
-		dev_err(dev, "only 2 data lanes are currently supported\n");
-		goto error_out;
+	lanes = ep_cfg.bus.mipi_csi2.num_data_lanes;
+	for (i = 0; i < ARRAY_SIZE(veyecam2m_links); i++) {
+		if (veyecam2m_links[i].lanes == lanes)
+			break;
 	}
-
-	/* Check the link frequency set in device tree */
-/*	if (!ep_cfg.nr_of_link_frequencies) {
-		dev_err(dev, "link-frequency property not found in DT\n");
+	if (i == ARRAY_SIZE(veyecam2m_links)) {
+		dev_err(dev, "%u data lanes are not supported\n", lanes);
 		goto error_out;
 	}
 
-	if (ep_cfg.nr_of_link_frequencies != 1 ||
-	    ep_cfg.link_frequencies[0] != VEYECAM2M_DEFAULT_LINK_FREQ) {
-		dev_err(dev, "Link frequency not supported: %lld\n",
-			ep_cfg.link_frequencies[0]);
-		goto error_out;
+	/* Check the link frequencies set in device tree */
+	for (j = 0; j < ep_cfg.nr_of_link_frequencies; j++) {
+		for (i = 0; i < ARRAY_SIZE(veyecam2m_links); i++) {
+			if (veyecam2m_links[i].lanes == lanes &&
+			    veyecam2m_links[i].link_freq == ep_cfg.link_frequencies[j])
+				break;
+		}
+		if (i == ARRAY_SIZE(veyecam2m_links))
+			dev_warn(dev, "Link frequency not supported: %lld\n",
+				 ep_cfg.link_frequencies[j]);
+		else
+			dt_freqs++;
+	}
+	if (ep_cfg.nr_of_link_frequencies && !dt_freqs)
+		dev_warn(dev, "no supported link frequency in DT, using the camera's own\n");
+
+	veyecam2m->num_lanes = lanes;
+	veyecam2m->num_link_freqs = 0;
+	for (i = 0; i < ARRAY_SIZE(veyecam2m_links) &&
+	     veyecam2m->num_link_freqs < VEYECAM2M_MAX_LINK_FREQS; i++) {
+		if (veyecam2m_links[i].lanes != lanes)
+			continue;
+		for (j = 0; j < ep_cfg.nr_of_link_frequencies; j++) {
+			if (ep_cfg.link_frequencies[j] == veyecam2m_links[i].link_freq)
+				break;
+		}
+		if (dt_freqs && j == ep_cfg.nr_of_link_frequencies)
+			continue;
+		veyecam2m->link_freqs[veyecam2m->num_link_freqs++] =
+			veyecam2m_links[i].link_freq;
 	}
-*/
 	ret = 0;
 
 error_out:
@@ -898,22 +1844,200 @@ error_out:
 	return ret;
 }
 
+/*
+ * Build the mode table from what the camera reports. The 327 family has no
+ * format capability table, its firmware always sends 1920x1080 and the
+ * video standard it is set to, PAL or NTSC, gives the frame rate.
+ */
+static int veyecam2m_read_modes(struct veyecam2m *veyecam2m)
+{
+	struct i2c_client *client = v4l2_get_subdevdata(&veyecam2m->sd);
+	struct veyecam2m_mode *mode;
+	u8 video_format;
+	int ret;
+
+	ret = veyecam2m_isp_read(veyecam2m, VEYECAM2M_ISP_VIDEO_FORMAT, &video_format);
+	if (ret) {
+		dev_err(&client->dev, "failed to read video format\n");
+		return ret;
+	}
+
+	veyecam2m->num_modes = 1;
+	veyecam2m->modes = devm_kcalloc(&client->dev, veyecam2m->num_modes,
+					sizeof(*veyecam2m->modes), GFP_KERNEL);
+	if (!veyecam2m->modes)
+		return -ENOMEM;
+
+	mode = &veyecam2m->modes[0];
+	mode->width = VEYECAM2M_WIDTH;
+	mode->height = VEYECAM2M_HEIGHT;
+	mode->max_framerate = video_format == VEYECAM2M_VIDEO_FORMAT_NTSC ?
+		VEYECAM2M_FRAMERATE_NTSC : VEYECAM2M_FRAMERATE_PAL;
+	dev_info(&client->dev, "mode %ux%u@%u\n",
+		 mode->width, mode->height, mode->max_framerate);
+
+	return 0;
+}
+
+/* Identify the booted camera and register its subdev */
+static int veyecam2m_probe_finish(struct veyecam2m *veyecam2m)
+{
+	struct i2c_client *client = v4l2_get_subdevdata(&veyecam2m->sd);
+	struct device *dev = &client->dev;
+	int ret;
+
+    ret = veyecam2m_identify_module(veyecam2m);
+	if (ret)
+		return ret;
+
+	ret = veyecam2m_read_modes(veyecam2m);
+	if (ret)
+		return ret;
+    
+	/* Set default mode to max resolution */
+	veyecam2m->mode = &veyecam2m->modes[0];
+	ret = veyecam2m_find_link(veyecam2m, veyecam2m->mode);
+	if (ret < 0) {
+		dev_err(dev, "no link frequency carries %ux%u@%u\n",
+			veyecam2m->mode->width, veyecam2m->mode->height,
+			veyecam2m->mode->max_framerate);
+		return ret;
+	}
+	veyecam2m->link_freq_index = ret;
+    //clk discontinues mode
+    veyecam2m_write_reg(veyecam2m,VEYECAM2M_REG_MIPI_CLK_MODE, 0xfe);
+    
+    ret = veyecam2m_init_controls(veyecam2m);
+	if (ret)
+		return ret;
+
+	/* Initialize subdev */
+	//veyecam2m->sd.internal_ops = &veyecam2m_internal_ops;
+	veyecam2m->sd.flags |= V4L2_SUBDEV_FL_HAS_DEVNODE | V4L2_SUBDEV_FL_HAS_EVENTS;
+	veyecam2m->sd.entity.function = MEDIA_ENT_F_CAM_SENSOR;
+    veyecam2m->sd.dev = &client->dev;
+	veyecam2m->sd.entity.ops = &veyecam2m_subdev_entity_ops;
+    /* Initialize source pad */
+	veyecam2m->pad.flags = MEDIA_PAD_FL_SOURCE;
+
+	/* Initialize default format */
+	veyecam2m_set_default_format(veyecam2m);
+	veyecam2m_write_reg(veyecam2m, VEYECAM2M_REG_YUV_SEQ,
+			    veyecam2m_yuv_seq(veyecam2m->fmt.code));
+    
+	ret = media_entity_pads_init(&veyecam2m->sd.entity, 1, &veyecam2m->pad);
+	if (ret)
+		goto error_handler_free;
+
+	/* The camera is powered on, let it idle once nobody uses it */
+	pm_runtime_set_active(dev);
+	pm_runtime_enable(dev);
+	pm_runtime_set_autosuspend_delay(dev, VEYECAM2M_AUTOSUSPEND_DELAY_MS);
+	pm_runtime_use_autosuspend(dev);
+
+	ret = v4l2_async_register_subdev(&veyecam2m->sd);
+	if (ret < 0) {
+		dev_err(dev, "failed to register sensor sub-device: %d\n", ret);
+		goto error_pm_runtime;
+	}
+
+	pm_runtime_mark_last_busy(dev);
+	pm_runtime_idle(dev);
+	return 0;
+
+error_pm_runtime:
+	pm_runtime_dont_use_autosuspend(dev);
+	pm_runtime_disable(dev);
+	pm_runtime_set_suspended(dev);
+	media_entity_cleanup(&veyecam2m->sd.entity);
+
+error_handler_free:
+	veyecam2m_free_controls(veyecam2m);
+
+	return ret;
+}
+
+/*
+ * Poll DEVICE_ID until the camera answers instead of sleeping through the
+ * worst case boot time, then finish the probe. A camera that does not
+ * boot or identify gets power cycled a few times before probe gives up.
+ */
+static void veyecam2m_probe_work(struct work_struct *work)
+{
+	struct veyecam2m *veyecam2m = container_of(to_delayed_work(work),
+						   struct veyecam2m, probe_work);
+	struct i2c_client *client = v4l2_get_subdevdata(&veyecam2m->sd);
+	s64 elapsed = ktime_ms_delta(ktime_get(), veyecam2m->probe_start);
+	u8 device_id;
+	int ret;
+
+	if (veyecam2m_read_reg(veyecam2m, VEYECAM2M_REG_DEVICE_ID, &device_id)) {
+		if (elapsed < VEYECAM2M_BOOT_TIMEOUT_MS) {
+			schedule_delayed_work(&veyecam2m->probe_work,
+					      msecs_to_jiffies(VEYECAM2M_BOOT_POLL_MS));
+			return;
+		}
+		dev_err(&client->dev, "camera did not answer within %d ms\n",
+			VEYECAM2M_BOOT_TIMEOUT_MS);
+		ret = -ENODEV;
+		goto error_power_off;
+	}
+	dev_dbg(&client->dev, "camera answered after %lld ms\n", elapsed);
+
+	ret = veyecam2m_probe_finish(veyecam2m);
+	if (ret)
+		goto error_power_off;
+
+	veyecam2m->registered = true;
+    //debug_printk("veyecam2m camera probed\n");
+	dev_info(&client->dev, "veyecam2m camera probed in %lld ms\n",
+		 ktime_ms_delta(ktime_get(), veyecam2m->probe_start));
+	return;
+
+error_power_off:
+	veyecam2m_power_off(veyecam2m);
+	if (++veyecam2m->probe_attempts < VEYECAM2M_PROBE_ATTEMPTS &&
+	    !veyecam2m_power_on(veyecam2m)) {
+		dev_warn(&client->dev, "veyecam2m camera probe failed (%d), retrying\n", ret);
+		veyecam2m->probe_start = ktime_get();
+		schedule_delayed_work(&veyecam2m->probe_work,
+				      msecs_to_jiffies(VEYECAM2M_BOOT_POLL_MS));
+		return;
+	}
+	/* stays bound but powered down, remove has nothing left to undo */
+	dev_err(&client->dev, "veyecam2m camera probe failed (%d)\n", ret);
+}
+
 static int veyecam2m_probe(struct i2c_client *client)
 {
 	struct device *dev = &client->dev;
 	struct veyecam2m *veyecam2m;
+	char name[32];
 	int ret;
 
 	veyecam2m = devm_kzalloc(&client->dev, sizeof(*veyecam2m), GFP_KERNEL);
 	if (!veyecam2m)
 		return -ENOMEM;
+	veyecam2m->probe_start = ktime_get();
+	spin_lock_init(&veyecam2m->stats.lock);
 
 	v4l2_i2c_subdev_init(&veyecam2m->sd, client, &veyecam2m_subdev_ops);
 
+	/* what the camera drives when the DT does not say */
+	veyecam2m->num_lanes = veyecam2m_links[0].lanes;
+	veyecam2m->link_freqs[0] = veyecam2m_links[0].link_freq;
+	veyecam2m->num_link_freqs = 1;
+
 	/* Check the hardware configuration in device tree */
-	if (veyecam2m_check_hwcfg(dev))
+	if (veyecam2m_check_hwcfg(veyecam2m, dev))
 		return -EINVAL;
 
+	veyecam2m->regmap = devm_regmap_init_i2c(client, &veyecam2m_regmap_config);
+	if (IS_ERR(veyecam2m->regmap)) {
+		dev_err(dev, "failed to init regmap\n");
+		return PTR_ERR(veyecam2m->regmap);
+	}
+
 	/* Get system clock (xclk) */
 /*	veyecam2m->xclk = devm_clk_get(dev, NULL);
 	if (IS_ERR(veyecam2m->xclk)) {
@@ -941,69 +2065,29 @@ static int veyecam2m_probe(struct i2c_client *client)
 		dev_err(dev, "failed to get powerdown GPIO\n");
 	}
     
+	/* per operation latencies and the last transactions */
+	snprintf(name, sizeof(name), "veyecam2m-%s", dev_name(dev));
+	veyecam2m->debugfs = debugfs_create_dir(name, NULL);
+	debugfs_create_file("stats", 0444, veyecam2m->debugfs, veyecam2m,
+			    &veyecam2m_stats_fops);
+
 	/*
 	 * The sensor must be powered for veyecam2m_identify_module()
 	 * to be able to read the CHIP_ID register
 	 */
 	ret = veyecam2m_power_on(veyecam2m);
-	if (ret)
+	if (ret) {
+		debugfs_remove_recursive(veyecam2m->debugfs);
 		return ret;
-
-    //usleep_range(100, 110);
-    msleep(100);
-    
-    ret = veyecam2m_identify_module(veyecam2m);
-	if (ret)
-		goto error_power_off;
-    
-	/* Set default mode to max resolution */
-	veyecam2m->mode = &supported_modes[0];
-    //clk discontinues mode
-    veyecam2m_write_reg(veyecam2m,0x000b, 0xfe);
-    
-    ret = veyecam2m_init_controls(veyecam2m);
-	if (ret)
-		goto error_power_off;
-
-	/* Initialize subdev */
-	//veyecam2m->sd.internal_ops = &veyecam2m_internal_ops;
-	veyecam2m->sd.flags |= V4L2_SUBDEV_FL_HAS_DEVNODE;
-	veyecam2m->sd.entity.function = MEDIA_ENT_F_CAM_SENSOR;
-    veyecam2m->sd.dev = &client->dev;
-	veyecam2m->sd.entity.ops = &veyecam2m_subdev_entity_ops;
-    /* Initialize source pad */
-	veyecam2m->pad.flags = MEDIA_PAD_FL_SOURCE;
-
-	/* Initialize default format */
-	veyecam2m_set_default_format(veyecam2m);
-    
-	ret = media_entity_pads_init(&veyecam2m->sd.entity, 1, &veyecam2m->pad);
-	if (ret)
-		goto error_handler_free;
-
-	ret = v4l2_async_register_subdev(&veyecam2m->sd);
-	if (ret < 0) {
-		dev_err(dev, "failed to register sensor sub-device: %d\n", ret);
-		goto error_media_entity;
 	}
 
-	//pm_runtime_set_active(&client->dev);
-	//pm_runtime_enable(&client->dev);
-	//pm_runtime_idle(&client->dev);
-    //debug_printk("veyecam2m camera probed\n");
-    dev_err(&client->dev, "veyecam2m camera probed\n");
-	return 0;
-
-error_media_entity:
-	media_entity_cleanup(&veyecam2m->sd.entity);
-
-error_handler_free:
-	veyecam2m_free_controls(veyecam2m);
-
-error_power_off:
-	veyecam2m_power_off(veyecam2m);
+	/* the camera takes a while to boot, finish from a work item */
+	INIT_DELAYED_WORK(&veyecam2m->probe_work, veyecam2m_probe_work);
+	INIT_DELAYED_WORK(&veyecam2m->meta_work, veyecam2m_meta_work);
+	schedule_delayed_work(&veyecam2m->probe_work,
+			      msecs_to_jiffies(VEYECAM2M_BOOT_POLL_MS));
 
-	return ret;
+	return 0;
 }
 
 static int veyecam2m_remove(struct i2c_client *client)
@@ -1011,15 +2095,33 @@ static int veyecam2m_remove(struct i2c_client *client)
 	struct v4l2_subdev *sd = i2c_get_clientdata(client);
 	struct veyecam2m *veyecam2m = to_veyecam2m(sd);
 
+	cancel_delayed_work_sync(&veyecam2m->probe_work);
+	debugfs_remove_recursive(veyecam2m->debugfs);
+	if (!veyecam2m->registered) {
+		/* nothing registered, power_off skips a camera already off */
+		veyecam2m_power_off(veyecam2m);
+		return 0;
+	}
+
+	/* meta_work posts events on the subdev node, stop it before it goes */
+	cancel_delayed_work_sync(&veyecam2m->meta_work);
 	v4l2_async_unregister_subdev(sd);
 	media_entity_cleanup(&sd->entity);
 	veyecam2m_free_controls(veyecam2m);
 
-	//pm_runtime_disable(&client->dev);
-	//pm_runtime_set_suspended(&client->dev);
+	pm_runtime_dont_use_autosuspend(&client->dev);
+	pm_runtime_disable(&client->dev);
+	if (!pm_runtime_status_suspended(&client->dev))
+		veyecam2m_power_off(veyecam2m);
+	pm_runtime_set_suspended(&client->dev);
 
 	return 0;
 }
+static const struct dev_pm_ops veyecam2m_pm_ops = {
+	SET_SYSTEM_SLEEP_PM_OPS(veyecam2m_suspend, veyecam2m_resume)
+	SET_RUNTIME_PM_OPS(veyecam2m_runtime_suspend, veyecam2m_runtime_resume, NULL)
+};
+
 static const struct i2c_device_id veyecam2m_id[] = {
 	{ "veyecam2m", 0 },
 	{}
@@ -1036,7 +2138,8 @@ static struct i2c_driver veyecam2m_i2c_driver = {
 	.driver = {
 		.of_match_table	= of_match_ptr(veyecam2m_dt_ids),
 		.name = "veyecam2m",
-		
+		.pm = &veyecam2m_pm_ops,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe_new = veyecam2m_probe,
 	.remove = veyecam2m_remove,
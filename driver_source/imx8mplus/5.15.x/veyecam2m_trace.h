@@ -0,0 +1,93 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Tracepoints for the VEYE veyecam2m camera driver.
+ *
+ * Register accesses report the register, the value (or the number of
+ * registers for bulk accesses), the result and how long the access took;
+ * streaming and power transitions report their result and duration.
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM veyecam2m
+
+#if !defined(_VEYECAM2M_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _VEYECAM2M_TRACE_H
+
+#include <linux/device.h>
+#include <linux/tracepoint.h>
+
+DECLARE_EVENT_CLASS(veyecam2m_reg,
+	TP_PROTO(struct device *dev, u16 reg, u32 val, u32 len, int ret, u64 ns),
+	TP_ARGS(dev, reg, val, len, ret, ns),
+	TP_STRUCT__entry(
+		__string(name, dev_name(dev))
+		__field(u16, reg)
+		__field(u32, val)
+		__field(u32, len)
+		__field(int, ret)
+		__field(u64, ns)
+	),
+	TP_fast_assign(
+		__assign_str(name, dev_name(dev));
+		__entry->reg = reg;
+		__entry->val = val;
+		__entry->len = len;
+		__entry->ret = ret;
+		__entry->ns = ns;
+	),
+	TP_printk("%s reg=0x%04x val=0x%02x len=%u ret=%d %llu ns",
+		  __get_str(name), __entry->reg, __entry->val, __entry->len,
+		  __entry->ret, __entry->ns)
+);
+
+DEFINE_EVENT(veyecam2m_reg, veyecam2m_write_reg,
+	TP_PROTO(struct device *dev, u16 reg, u32 val, u32 len, int ret, u64 ns),
+	TP_ARGS(dev, reg, val, len, ret, ns));
+
+DEFINE_EVENT(veyecam2m_reg, veyecam2m_read_reg,
+	TP_PROTO(struct device *dev, u16 reg, u32 val, u32 len, int ret, u64 ns),
+	TP_ARGS(dev, reg, val, len, ret, ns));
+
+DEFINE_EVENT(veyecam2m_reg, veyecam2m_write_regs,
+	TP_PROTO(struct device *dev, u16 reg, u32 val, u32 len, int ret, u64 ns),
+	TP_ARGS(dev, reg, val, len, ret, ns));
+
+DECLARE_EVENT_CLASS(veyecam2m_op,
+	TP_PROTO(struct device *dev, int ret, u64 ns),
+	TP_ARGS(dev, ret, ns),
+	TP_STRUCT__entry(
+		__string(name, dev_name(dev))
+		__field(int, ret)
+		__field(u64, ns)
+	),
+	TP_fast_assign(
+		__assign_str(name, dev_name(dev));
+		__entry->ret = ret;
+		__entry->ns = ns;
+	),
+	TP_printk("%s ret=%d %llu ns", __get_str(name), __entry->ret, __entry->ns)
+);
+
+DEFINE_EVENT(veyecam2m_op, veyecam2m_start_streaming,
+	TP_PROTO(struct device *dev, int ret, u64 ns),
+	TP_ARGS(dev, ret, ns));
+
+DEFINE_EVENT(veyecam2m_op, veyecam2m_stop_streaming,
+	TP_PROTO(struct device *dev, int ret, u64 ns),
+	TP_ARGS(dev, ret, ns));
+
+DEFINE_EVENT(veyecam2m_op, veyecam2m_power_on,
+	TP_PROTO(struct device *dev, int ret, u64 ns),
+	TP_ARGS(dev, ret, ns));
+
+DEFINE_EVENT(veyecam2m_op, veyecam2m_power_off,
+	TP_PROTO(struct device *dev, int ret, u64 ns),
+	TP_ARGS(dev, ret, ns));
+
+#endif /* _VEYECAM2M_TRACE_H */
+
+/* the driver is built out of the kernel's trace/events directory */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE veyecam2m_trace
+#include <trace/define_trace.h>
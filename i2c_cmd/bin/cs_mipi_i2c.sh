@@ -83,41 +83,36 @@ print_usage()
 ########################this is fpga reglist#####################
 deviceID=0x00;
 HardWare=0x01;
+LoadingDone=0x02;
 Csi2_Enable=0x03;
-CAM_CAP_L=0X04;
-CAM_CAP_H=0X05;
+CAM_CAP_L=0x04;
+CAM_CAP_H=0x05;
 I2c_addr=0x06;
-
 StreamMode=0x0E;
 SlaveMode=0x0F;
-
 StrobeIO_MODE=0x10;
 Strobe_sel=0x11;
 Strobe_value=0x12;
-
 TriggerIO_MODE=0x14;
 Trigger_sel=0x15;
 Trigger_value=0x16;
-
 ExtTrigEdge=0x18;
 ExtTrigDebouncerEn=0x19;
-ExtTrigDebouncerTimeL=0x1a;
-ExtTrigDebouncerTimeM=0x1b;
-ExtTrigDebouncerTimeH=0x1c;
-SoftTrig=0x1d;
-TrigDlyL=0x1e;
-TrigDlyM=0x1f;
+ExtTrigDebouncerTimeL=0x1A;
+ExtTrigDebouncerTimeM=0x1B;
+ExtTrigDebouncerTimeH=0x1C;
+SoftTrig=0x1D;
+TrigDlyL=0x1E;
+TrigDlyM=0x1F;
 TrigDlyH=0x20;
 TrigDlyE=0x21;
 PickModeEnable=0x26;
 PickOne=0x27;
 DiscardedQnt=0x28;
-
 AutoTrigCntMaxL=0xC7;
-AutoTrigCntMaxM=0XC8;
-AutoTrigCntMaxH=0XC9;
+AutoTrigCntMaxM=0xC8;
+AutoTrigCntMaxH=0xC9;
 AutoTrigEnable=0xCA;
-
 MIPI_COUNT_L=0xCE;
 MIPI_COUNT_H=0xCF;
 MIPI_STAT=0xD0;
@@ -128,7 +123,7 @@ PRODUCTID_L=0x0102;
 PRODUCTID_H=0x0103;
 SYSTEM_RESET=0x0104;
 PARAM_SAVE=0x0105;
-VIDEOFMT_CAP=0x0106; 
+VIDEOFMT_CAP=0x0106;
 VIDEOFMT_NUM=0x0107;
 FMTCAP_WIDTH_L=0x0108;
 FMTCAP_WIDTH_H=0x0109;
@@ -136,7 +131,6 @@ FMTCAP_HEIGHT_L=0x010A;
 FMTCAP_HEIGHT_H=0x010B;
 FMTCAP_FRAMRAT_L=0x010C;
 FMTCAP_FRAMRAT_H=0x010D;
-
 FMT_WIDTH_L=0x0180;
 FMT_WIDTH_H=0x0181;
 FMT_HEIGHT_L=0x0182;
@@ -148,31 +142,25 @@ SYSTEM_REBOOT=0x0187;
 NEW_FMT_FRAMRAT_MODE=0x0188;
 NEW_FMT_FRAMRAT_L=0x0189;
 NEW_FMT_FRAMRAT_H=0x018A;
-
 ISP_CAP_L=0x0200;
 ISP_CAP_M=0x0201;
 ISP_CAP_H=0x0202;
 ISP_CAP_E=0x0203;
 POWER_HZ=0x0204;
-
 DAY_NIGHT_MODE=0x0205;
-
 CSC_HUE=0x0206;
 CSC_CONTT=0x0207;
 CSC_SATU=0x0208;
-
 EXP_FRM_MODE=0x020F;
 AE_MODE=0x0210;
 EXP_TIME_L=0x0211;
 EXP_TIME_M=0x0212;
 EXP_TIME_H=0x0213;
 EXP_TIME_E=0x0214;
-
 AGAIN_NOW_DEC=0x0215;
 AGAIN_NOW_INTER=0x0216;
 DGAIN_NOW_DEC=0x0217;
 DGAIN_NOW_INTER=0x0218;
-
 AE_SPEED=0x0219;
 AE_TARGET=0x021A;
 AE_MAXTIME_L=0x021B;
@@ -181,8 +169,6 @@ AE_MAXTIME_H=0x021D;
 AE_MAXTIME_E=0x021E;
 AE_MAXGAIN_DEC=0x021F;
 AE_MAXGAIN_INTER=0x0220;
-
-
 ME_TIME_L=0x0226;
 ME_TIME_M=0x0227;
 ME_TIME_H=0x0228;
@@ -191,22 +177,19 @@ ME_AGAIN_DEC=0x022A;
 ME_AGAIN_INTER=0x022B;
 ME_DGAIN_DEC=0x022C;
 ME_DGAIN_INTER=0x022D;
-AE_SLOW_GAIN_DEC=0x22E;
-AE_SLOW_GAIN_INTER=0x22F;
+AE_SLOW_GAIN_DEC=0x022E;
+AE_SLOW_GAIN_INTER=0x022F;
 AWB_MODE=0x0230;
 WB_RGAIN=0x0231;
 WB_GGAIN=0x0232;
 WB_BGAIN=0x0233;
 WB_COLORTEMPL=0x0235;
 WB_COLORTEMPH=0x0236;
-
 MWB_COLORTEMPL=0x023A;
 MWB_COLORTEMPH=0x023B;
-
 MWB_RGAIN=0x023C;
 MWB_GGAIN=0x023D;
 MWB_BGAIN=0x023E;
-
 DME_TIME_L=0x0240;
 DME_TIME_M=0x0241;
 DME_TIME_H=0x0242;
@@ -215,11 +198,11 @@ DME_AGAIN_DEC=0x0244;
 DME_AGAIN_INTER=0x0245;
 DME_DGAIN_DEC=0x0246;
 DME_DGAIN_INTER=0x0247;
-
-SNSOR_REG_FLG=0x700;
-SNSOR_REG_ADDR_L=0x701;
-SNSOR_REG_ADDR_H=0x702;
-SNSOR_REG_VAL=0x703;
+########################this is sensor window reglist#####################
+SNSOR_REG_FLG=0x0700;
+SNSOR_REG_ADDR_L=0x0701;
+SNSOR_REG_ADDR_H=0x0702;
+SNSOR_REG_VAL=0x0703;
 
 ######################parse arg###################################
 MODE=read;
@@ -1167,6 +1150,10 @@ read_senreg()
     local data_h=0;
     local res=0;
     senregaddr=$PARAM1;
+    if [ -x ./i2c_senreg ] ; then
+        ./i2c_senreg $I2C_DEV $I2C_ADDR r $senregaddr;
+        return;
+    fi
     data_h=$((senregaddr>>8&0xFF));
     data_l=$((senregaddr&0xFF));
     res=$(./i2c_write $I2C_DEV $I2C_ADDR $SNSOR_REG_FLG 0x0);
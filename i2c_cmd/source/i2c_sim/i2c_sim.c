@@ -0,0 +1,719 @@
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "i2c_comm.h"
+
+/*
+ * libi2c_sim.so - camera register map simulator for the i2c tools.
+ *
+ * Preloaded into i2c_read, i2c_write and the rest, it takes over
+ * /dev/i2c-<bus> for the simulated buses and answers I2C_RDWR, I2C_SLAVE
+ * and plain read()/write() the way the cameras do, so the tools and the
+ * scripts run unchanged on a build host:
+ *
+ *   (cd ../i2c_tools && CC=gcc sh make.sh)
+ *   I2C_SIM="0:0x3b:imx307,1:0x3b:veye" LD_PRELOAD=/path/to/libi2c_sim.so \
+ *       ./cs_mipi_i2c.sh -r -f videofmtcap
+ *
+ * I2C_SIM lists <bus>:<address>:<model>, model being imx307 or sc132 (CS
+ * register map) or veye (VEYE-MIPI-327 register map), default
+ * "0:0x3b:imx307". Buses not listed go to the real device.
+ *
+ * What is simulated:
+ *   cs    product id, firmware version, FMTCAP table of the model,
+ *         LoadingDone after SYSTEM_RESET/SYSTEM_REBOOT, I2c_addr moves the
+ *         device, MIPI_COUNT counts frames while Csi2_Enable is set, writes
+ *         to const and ro registers of the map are ignored, and the
+ *         SNSOR_REG window answers after I2C_SIM_SENREG_US (sensor
+ *         registers 0x3000-0x5fff exist; the flag keeps the request code
+ *         on success, others fail with flag 0xff). Sensor register writes
+ *         are only modelled for the request code in I2C_SIM_SENREG_WRITE,
+ *         the real one is not documented.
+ *   veye  device id 0x06, IMX327 sensor id, and the ISP window: ISP_CMD 0
+ *         writes the parameter, ISP_CMD 1 makes ISP_RVAL valid after
+ *         I2C_SIM_ISP_US
+ *
+ * Bus time is simulated too, every transfer sleeps for what it would take
+ * on the wire at I2C_SIM_KHZ (default 400, 0 for no delay) plus
+ * I2C_SIM_XFER_US (default 20) of ioctl overhead. Each bus is busy only
+ * with its own transfers, so buses run in parallel as on the real board.
+ * I2C_SIM_STATS=1 prints what the process sent on stderr at exit.
+ *
+ * Device state lives in I2C_SIM_DIR (default /tmp/i2c_sim), one mmap'ed
+ * file per device, so a write by one tool invocation is seen by the next.
+ * Remove the directory to power cycle the cameras.
+ */
+
+#define SIM_DIR			"/tmp/i2c_sim"
+#define SIM_MAGIC		0x4d495343	/* "CSIM" */
+#define SIM_MAX_DEV		16
+#define SIM_MAX_FD		1024
+
+#define SIM_MODEL_IMX307	0
+#define SIM_MODEL_SC132		1
+#define SIM_MODEL_VEYE		2
+
+/* VEYE-MIPI-327 registers, see regmap/veye_regs.txt */
+#define SIM_VEYE_HW_VERSION	0x00
+#define SIM_VEYE_DEVICE_ID	0x01
+#define SIM_VEYE_ISP_ADDR_H	0x10
+#define SIM_VEYE_ISP_ADDR_L	0x11
+#define SIM_VEYE_ISP_WVAL	0x12
+#define SIM_VEYE_ISP_CMD	0x13
+#define SIM_VEYE_ISP_RVAL	0x14
+#define SIM_VEYE_SENSOR_ID_L	0x20
+#define SIM_VEYE_SENSOR_ID_H	0x21
+#define SIM_VEYE_BOARD_TYPE	0x25
+
+/*
+ * sensor window flag, as read_senreg in cs_mipi_i2c.sh knows it: armed with
+ * the request code, it keeps that code on success and turns 0xFF on failure
+ */
+#define SIM_SENREG_FAIL		0xFF
+
+struct sim_mode {
+	uint16_t width;
+	uint16_t height;
+	uint16_t fps;
+};
+
+static const struct sim_mode imx307_modes[] = {
+	{ 1920, 1080, 30 },
+	{ 1280, 720, 60 },
+	{ 640, 480, 130 },
+};
+
+static const struct sim_mode sc132_modes[] = {
+	{ 1280, 1080, 45 },
+	{ 1080, 1280, 45 },
+	{ 1280, 720, 60 },
+	{ 720, 1280, 60 },
+	{ 640, 480, 120 },
+	{ 480, 640, 120 },
+};
+
+/* shared between processes through the state file */
+struct sim_state {
+	uint32_t magic;
+	uint32_t size;
+	uint32_t model;
+	uint8_t addr;			/* current address, follows I2c_addr */
+	uint8_t senreg_busy;
+	uint8_t isp_busy;
+	uint8_t pad;
+	uint16_t ptr;			/* register pointer for plain read() */
+	uint64_t boot_done_ns;
+	uint64_t stream_ns;
+	uint64_t senreg_done_ns;
+	uint64_t isp_done_ns;
+	uint8_t reg[0x10000];
+	uint8_t aux[0x10000];		/* cs: sensor registers, veye: isp parameters */
+};
+
+struct sim_dev {
+	int bus;
+	uint8_t addr;			/* address at power up, names the file with model */
+	int model;
+	int fd;
+	struct sim_state *st;
+};
+
+struct sim_fd {
+	int bus;			/* -1 when not a simulated bus */
+	uint8_t addr;
+};
+
+static struct sim_dev devs[SIM_MAX_DEV];
+static int num_devs;
+static struct sim_fd fds[SIM_MAX_FD];
+/* guards the statistics */
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+/* one per device entry, a bus uses the lock of its first device */
+static pthread_mutex_t bus_locks[SIM_MAX_DEV + 1];
+
+static long sim_khz = 400;
+static long sim_xfer_us = 20;
+static long sim_senreg_us = 2000;
+static long sim_senreg_write = -1;	/* write request code, -1 for none */
+static long sim_isp_us = 3000;
+static long sim_boot_us = 300000;
+static const char *sim_dir = SIM_DIR;
+static unsigned long long stat_xfers, stat_msgs, stat_bytes, stat_bus_us;
+
+static int (*real_open)(const char *, int, ...);
+static int (*real_open64)(const char *, int, ...);
+static int (*real_close)(int);
+static int (*real_ioctl)(int, unsigned long, ...);
+static ssize_t (*real_read)(int, void *, size_t);
+static ssize_t (*real_write)(int, const void *, size_t);
+
+static uint64_t sim_now_ns(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static long sim_env(const char *name, long def)
+{
+	const char *env = getenv(name);
+
+	return env != NULL && env[0] != '\0' ? strtol(env, NULL, 0) : def;
+}
+
+static void sim_report(void)
+{
+	fprintf(stderr, "i2c_sim: %llu transfers, %llu messages, %llu bytes, %llu us on the bus\n",
+		stat_xfers, stat_msgs, stat_bytes, stat_bus_us);
+}
+
+static void sim_put16(uint8_t *p, uint16_t v)
+{
+	p[0] = v & 0xff;
+	p[1] = v >> 8;
+}
+
+static void sim_init_cs(struct sim_state *st)
+{
+	const struct sim_mode *modes = st->model == SIM_MODEL_SC132 ? sc132_modes : imx307_modes;
+	int num = st->model == SIM_MODEL_SC132 ? sizeof(sc132_modes) / sizeof(sc132_modes[0]) :
+		  sizeof(imx307_modes) / sizeof(imx307_modes[0]);
+	uint8_t *r = st->reg;
+	int i;
+
+	r[CS_REG_DEVICEID] = 0x5A;
+	r[CS_REG_HARDWARE] = 0x01;
+	r[CS_REG_LOADINGDONE] = 0x01;
+	sim_put16(r + CS_REG_CAM_CAP, 0x0003);
+	r[CS_REG_I2C_ADDR] = st->addr;
+	sim_put16(r + CS_REG_ARM_VER, 0x0102);
+	sim_put16(r + CS_REG_PRODUCTID, st->model == SIM_MODEL_SC132 ? 0x0132 : 0x0037);
+	r[CS_REG_VIDEOFMT_CAP] = 0x01;
+	r[CS_REG_VIDEOFMT_NUM] = num;
+	for (i = 0; i < num; i++)
+	{
+		sim_put16(r + CS_REG_FMTCAP_WIDTH + i * 6, modes[i].width);
+		sim_put16(r + CS_REG_FMTCAP_HEIGHT + i * 6, modes[i].height);
+		sim_put16(r + CS_REG_FMTCAP_FRAMRAT + i * 6, modes[i].fps);
+	}
+	sim_put16(r + CS_REG_FMT_WIDTH, modes[0].width);
+	sim_put16(r + CS_REG_FMT_HEIGHT, modes[0].height);
+	sim_put16(r + CS_REG_FMT_FRAMRAT, modes[0].fps);
+	sim_put16(r + CS_REG_NEW_FMT_FRAMRAT, modes[0].fps * 100);
+	r[CS_REG_ISP_CAP] = 0xFF;
+	r[CS_REG_ISP_CAP + 1] = 0x03;
+	r[CS_REG_POWER_HZ] = 0x00;
+	r[CS_REG_AE_MODE] = 0x00;
+	r[CS_REG_AE_TARGET] = 0x80;
+	r[CS_REG_AE_SPEED] = 0x64;
+	sim_put16(r + CS_REG_EXP_TIME, 10000);
+	r[CS_REG_AWB_MODE] = 0x00;
+	sim_put16(r + CS_REG_WB_COLORTEMP, 5000);
+	for (i = 0; i < 0x10000; i++)
+		st->aux[i] = (i * 7) ^ (i >> 8);
+}
+
+static void sim_init_veye(struct sim_state *st)
+{
+	st->reg[SIM_VEYE_HW_VERSION] = 0x01;
+	st->reg[SIM_VEYE_DEVICE_ID] = 0x06;
+	st->reg[SIM_VEYE_SENSOR_ID_L] = 0x03;
+	st->reg[SIM_VEYE_SENSOR_ID_H] = 0x27;
+	st->reg[SIM_VEYE_BOARD_TYPE] = 0x4C;
+	/* release date 2021-06-15, video format and wdr mode */
+	st->aux[0xDA5C] = 0x21;
+	st->aux[0xDA5D] = 0x06;
+	st->aux[0xDA52] = 0x15;
+	st->aux[0xDEC2] = 0x01;
+	st->aux[0xDB32] = 0x00;
+}
+
+static void sim_init(struct sim_state *st, int model, uint8_t addr)
+{
+	memset(st, 0, sizeof(*st));
+	st->magic = SIM_MAGIC;
+	st->size = sizeof(*st);
+	st->model = model;
+	st->addr = addr;
+	if (model == SIM_MODEL_VEYE)
+		sim_init_veye(st);
+	else
+		sim_init_cs(st);
+}
+
+static struct sim_state *sim_map(struct sim_dev *d)
+{
+	char path[256];
+	void *map;
+	int fd;
+
+	if (d->st != NULL)
+		return d->st;
+	mkdir(sim_dir, 0755);
+	snprintf(path, sizeof(path), "%s/i2c-%d-%02x-%d", sim_dir, d->bus, d->addr, d->model);
+	fd = real_open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+		return NULL;
+	flock(fd, LOCK_EX);
+	if (ftruncate(fd, sizeof(struct sim_state)) < 0)
+		goto err;
+	map = mmap(NULL, sizeof(struct sim_state), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+		goto err;
+	d->st = map;
+	d->fd = fd;
+	if (d->st->magic != SIM_MAGIC || d->st->size != sizeof(struct sim_state))
+		sim_init(d->st, d->model, d->addr);
+	flock(fd, LOCK_UN);
+	return d->st;
+
+err:
+	flock(fd, LOCK_UN);
+	real_close(fd);
+	return NULL;
+}
+
+static struct sim_dev *sim_find(int bus, uint8_t addr)
+{
+	int i;
+
+	for (i = 0; i < num_devs; i++)
+	{
+		if (devs[i].bus == bus && sim_map(&devs[i]) != NULL && devs[i].st->addr == addr)
+			return &devs[i];
+	}
+	return NULL;
+}
+
+static int sim_bus_known(int bus)
+{
+	int i;
+
+	for (i = 0; i < num_devs; i++)
+	{
+		if (devs[i].bus == bus)
+			return 1;
+	}
+	return 0;
+}
+
+/* complete whatever the firmware would have finished by now */
+static void sim_update(struct sim_state *st, uint64_t now)
+{
+	uint16_t saddr;
+
+	if (st->model != SIM_MODEL_VEYE && st->boot_done_ns && now >= st->boot_done_ns)
+	{
+		st->reg[CS_REG_LOADINGDONE] = 0x01;
+		st->boot_done_ns = 0;
+	}
+	if (st->senreg_busy && now >= st->senreg_done_ns)
+	{
+		st->senreg_busy = 0;
+		saddr = st->reg[CS_REG_SNSOR_REG_ADDR] | (st->reg[CS_REG_SNSOR_REG_ADDR + 1] << 8);
+		if (saddr < 0x3000 || saddr > 0x5FFF)
+		{
+			st->reg[CS_REG_SNSOR_REG_FLG] = SIM_SENREG_FAIL;
+		}
+		else
+		{
+			if (st->reg[CS_REG_SNSOR_REG_FLG] == sim_senreg_write)
+				st->aux[saddr] = st->reg[CS_REG_SNSOR_REG_VAL];
+			else
+				st->reg[CS_REG_SNSOR_REG_VAL] = st->aux[saddr];
+		}
+	}
+	if (st->isp_busy && now >= st->isp_done_ns)
+	{
+		st->isp_busy = 0;
+		st->reg[SIM_VEYE_ISP_RVAL] =
+			st->aux[(st->reg[SIM_VEYE_ISP_ADDR_H] << 8) | st->reg[SIM_VEYE_ISP_ADDR_L]];
+	}
+}
+
+static uint8_t sim_read_reg(struct sim_state *st, uint16_t reg, uint64_t now)
+{
+	uint64_t frames;
+	uint16_t fps;
+
+	if (st->model != SIM_MODEL_VEYE && (reg == CS_REG_MIPI_COUNT || reg == CS_REG_MIPI_COUNT + 1))
+	{
+		fps = st->reg[CS_REG_FMT_FRAMRAT] | (st->reg[CS_REG_FMT_FRAMRAT + 1] << 8);
+		frames = st->reg[CS_REG_CSI2_ENABLE] ? (now - st->stream_ns) * fps / 1000000000ULL : 0;
+		return reg == CS_REG_MIPI_COUNT ? frames & 0xff : (frames >> 8) & 0xff;
+	}
+	return st->reg[reg];
+}
+
+static void sim_write_cs(struct sim_dev *d, uint16_t reg, uint8_t val, uint64_t now)
+{
+	struct sim_state *st = d->st;
+	const struct reg_desc *desc = cs_reg_at(reg);
+
+	if (desc != NULL && (desc->access == REG_ACC_CONST || desc->access == REG_ACC_RO))
+		return;
+	st->reg[reg] = val;
+	switch (reg)
+	{
+	case CS_REG_I2C_ADDR:
+		if (val > 0 && val < 0x80)
+			st->addr = val;
+		break;
+	case CS_REG_CSI2_ENABLE:
+		st->stream_ns = now;
+		break;
+	case CS_REG_SYSTEM_RESET:
+		sim_init(st, d->model, d->addr);
+		/* fall through */
+	case CS_REG_SYSTEM_REBOOT:
+		st->reg[CS_REG_LOADINGDONE] = 0x00;
+		st->boot_done_ns = now + sim_boot_us * 1000ULL;
+		st->senreg_busy = 0;
+		break;
+	case CS_REG_SNSOR_REG_FLG:
+		st->senreg_busy = 0;
+		break;
+	case CS_REG_SNSOR_REG_ADDR + 1:
+		st->senreg_busy = 1;
+		st->senreg_done_ns = now + sim_senreg_us * 1000ULL;
+		break;
+	}
+}
+
+static void sim_write_veye(struct sim_state *st, uint16_t reg, uint8_t val, uint64_t now)
+{
+	if (reg == SIM_VEYE_HW_VERSION || reg == SIM_VEYE_DEVICE_ID || reg == SIM_VEYE_ISP_RVAL ||
+	    reg == SIM_VEYE_SENSOR_ID_L || reg == SIM_VEYE_SENSOR_ID_H || reg == SIM_VEYE_BOARD_TYPE)
+		return;
+	st->reg[reg] = val;
+	if (reg != SIM_VEYE_ISP_CMD)
+		return;
+	if (val == 0)
+	{
+		st->aux[(st->reg[SIM_VEYE_ISP_ADDR_H] << 8) | st->reg[SIM_VEYE_ISP_ADDR_L]] =
+			st->reg[SIM_VEYE_ISP_WVAL];
+	}
+	else
+	{
+		st->isp_busy = 1;
+		st->isp_done_ns = now + sim_isp_us * 1000ULL;
+	}
+}
+
+/* one message addressed to a device, 16 bit big endian register pointer first */
+static int sim_msg(int bus, struct i2c_msg *msg)
+{
+	struct sim_dev *d;
+	struct sim_state *st;
+	uint64_t now = sim_now_ns();
+	int i;
+
+	d = sim_find(bus, msg->addr);
+	if (d == NULL)
+		return -1;
+	st = d->st;
+	sim_update(st, now);
+	if (msg->flags & I2C_M_RD)
+	{
+		for (i = 0; i < msg->len; i++)
+			msg->buf[i] = sim_read_reg(st, st->ptr++, now);
+		return 0;
+	}
+	if (msg->len < 2)
+		return 0;
+	st->ptr = (msg->buf[0] << 8) | msg->buf[1];
+	for (i = 2; i < msg->len; i++)
+	{
+		if (d->model == SIM_MODEL_VEYE)
+			sim_write_veye(st, st->ptr, msg->buf[i], now);
+		else
+			sim_write_cs(d, st->ptr, msg->buf[i], now);
+		st->ptr++;
+		/* I2c_addr moves the device, the rest of the message goes nowhere */
+		if (st->addr != msg->addr)
+			break;
+	}
+	return 0;
+}
+
+/* the time the messages take on the wire: 9 clocks a byte plus start and stop */
+static long sim_wire_us(struct i2c_msg *msgs, int num)
+{
+	uint64_t clocks = 0;
+	long us;
+	int i;
+
+	for (i = 0; i < num; i++)
+		clocks += 9 * (1 + msgs[i].len) + 2;
+	us = sim_xfer_us + (sim_khz > 0 ? clocks * 1000 / sim_khz : 0);
+	pthread_mutex_lock(&sim_lock);
+	stat_xfers++;
+	stat_msgs += num;
+	stat_bus_us += us;
+	for (i = 0; i < num; i++)
+		stat_bytes += msgs[i].len;
+	pthread_mutex_unlock(&sim_lock);
+	return us;
+}
+
+static void sim_delay(long us)
+{
+	struct timespec ts;
+
+	if (sim_khz <= 0)
+		return;
+	ts.tv_sec = us / 1000000;
+	ts.tv_nsec = (us % 1000000) * 1000;
+	nanosleep(&ts, NULL);
+}
+
+static pthread_mutex_t *sim_bus_lock(int bus)
+{
+	int i;
+
+	for (i = 0; i < num_devs; i++)
+	{
+		if (devs[i].bus == bus)
+			return &bus_locks[i];
+	}
+	return &bus_locks[SIM_MAX_DEV];
+}
+
+/*
+ * A bus carries one transfer at a time, for its whole time on the wire,
+ * while transfers on other buses go on meanwhile: the lock of the bus
+ * keeps out other threads, the flock of its state files other processes.
+ */
+static int sim_xfer(int bus, struct i2c_msg *msgs, int num)
+{
+	pthread_mutex_t *lock = sim_bus_lock(bus);
+	int i, j, ret = 0;
+
+	pthread_mutex_lock(lock);
+	for (i = 0; i < num_devs; i++)
+	{
+		if (devs[i].bus == bus && sim_map(&devs[i]) != NULL)
+			flock(devs[i].fd, LOCK_EX);
+	}
+	for (j = 0; j < num && ret == 0; j++)
+		ret = sim_msg(bus, &msgs[j]);
+	sim_delay(sim_wire_us(msgs, j));
+	for (i = 0; i < num_devs; i++)
+	{
+		if (devs[i].bus == bus && devs[i].st != NULL)
+			flock(devs[i].fd, LOCK_UN);
+	}
+	pthread_mutex_unlock(lock);
+	if (ret < 0)
+	{
+		errno = ENXIO;
+		return -1;
+	}
+	return num;
+}
+
+static int sim_parse(const char *cfg)
+{
+	char buf[512], *tok, *save, *model;
+	unsigned int bus, addr;
+	int n;
+
+	snprintf(buf, sizeof(buf), "%s", cfg);
+	for (tok = strtok_r(buf, ", ", &save); tok != NULL; tok = strtok_r(NULL, ", ", &save))
+	{
+		model = strrchr(tok, ':');
+		if (num_devs == SIM_MAX_DEV || model == NULL ||
+		    sscanf(tok, "%u:%i%n", &bus, &addr, &n) != 2 || tok + n != model || addr > 0x7F)
+			goto err;
+		model++;
+		if (strcmp(model, "imx307") == 0)
+			devs[num_devs].model = SIM_MODEL_IMX307;
+		else if (strcmp(model, "sc132") == 0)
+			devs[num_devs].model = SIM_MODEL_SC132;
+		else if (strcmp(model, "veye") == 0)
+			devs[num_devs].model = SIM_MODEL_VEYE;
+		else
+			goto err;
+		devs[num_devs].bus = bus;
+		devs[num_devs].addr = addr;
+		devs[num_devs].fd = -1;
+		num_devs++;
+	}
+	return 0;
+
+err:
+	fprintf(stderr, "i2c_sim: bad I2C_SIM entry %s, expected <bus>:<address>:<imx307|sc132|veye>\n", tok);
+	return -1;
+}
+
+__attribute__((constructor)) static void sim_setup(void)
+{
+	static int done;
+	const char *env;
+	int i;
+
+	/* another constructor may open files before this one ran */
+	if (done)
+		return;
+	done = 1;
+	real_open = dlsym(RTLD_NEXT, "open");
+	real_open64 = dlsym(RTLD_NEXT, "open64");
+	real_close = dlsym(RTLD_NEXT, "close");
+	real_ioctl = dlsym(RTLD_NEXT, "ioctl");
+	real_read = dlsym(RTLD_NEXT, "read");
+	real_write = dlsym(RTLD_NEXT, "write");
+	for (i = 0; i < SIM_MAX_FD; i++)
+		fds[i].bus = -1;
+	for (i = 0; i <= SIM_MAX_DEV; i++)
+		pthread_mutex_init(&bus_locks[i], NULL);
+
+	env = getenv("I2C_SIM");
+	if (sim_parse(env != NULL && env[0] != '\0' ? env : "0:0x3b:imx307") < 0)
+		num_devs = 0;
+	if ((env = getenv("I2C_SIM_DIR")) != NULL && env[0] != '\0')
+		sim_dir = env;
+	sim_khz = sim_env("I2C_SIM_KHZ", sim_khz);
+	sim_xfer_us = sim_env("I2C_SIM_XFER_US", sim_xfer_us);
+	sim_senreg_us = sim_env("I2C_SIM_SENREG_US", sim_senreg_us);
+	sim_senreg_write = sim_env("I2C_SIM_SENREG_WRITE", sim_senreg_write);
+	sim_isp_us = sim_env("I2C_SIM_ISP_US", sim_isp_us);
+	sim_boot_us = sim_env("I2C_SIM_BOOT_US", sim_boot_us);
+	if (sim_env("I2C_SIM_STATS", 0))
+		atexit(sim_report);
+}
+
+static int sim_open(int (*next)(const char *, int, ...), const char *path, int flags, mode_t mode)
+{
+	int bus, n, fd;
+
+	if (sscanf(path, "/dev/i2c-%d%n", &bus, &n) != 1 || path[n] != '\0' || !sim_bus_known(bus))
+		return next(path, flags, mode);
+	fd = next("/dev/null", flags & O_ACCMODE);
+	if (fd >= 0 && fd < SIM_MAX_FD)
+	{
+		fds[fd].bus = bus;
+		fds[fd].addr = 0;
+	}
+	return fd;
+}
+
+int open(const char *path, int flags, ...)
+{
+	mode_t mode = 0;
+	va_list ap;
+
+	sim_setup();
+
+	if (flags & (O_CREAT | O_TMPFILE))
+	{
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+	return sim_open(real_open, path, flags, mode);
+}
+
+int open64(const char *path, int flags, ...)
+{
+	mode_t mode = 0;
+	va_list ap;
+
+	sim_setup();
+
+	if (flags & (O_CREAT | O_TMPFILE))
+	{
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+	return sim_open(real_open64, path, flags, mode);
+}
+
+int close(int fd)
+{
+	if (fd >= 0 && fd < SIM_MAX_FD)
+		fds[fd].bus = -1;
+	return real_close(fd);
+}
+
+int ioctl(int fd, unsigned long request, ...)
+{
+	struct i2c_rdwr_ioctl_data *rdwr;
+	va_list ap;
+	void *arg;
+
+	va_start(ap, request);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+	if (fd < 0 || fd >= SIM_MAX_FD || fds[fd].bus < 0)
+		return real_ioctl(fd, request, arg);
+
+	switch (request)
+	{
+	case I2C_SLAVE:
+	case I2C_SLAVE_FORCE:
+		if ((unsigned long)arg > 0x7F)
+			break;
+		fds[fd].addr = (unsigned long)arg;
+		return 0;
+	case I2C_FUNCS:
+		*(unsigned long *)arg = I2C_FUNC_I2C;
+		return 0;
+	case I2C_TIMEOUT:
+	case I2C_RETRIES:
+	case I2C_TENBIT:
+		return 0;
+	case I2C_RDWR:
+		rdwr = arg;
+		if (rdwr->nmsgs > I2C_RDWR_IOCTL_MAX_MSGS)
+			break;
+		return sim_xfer(fds[fd].bus, rdwr->msgs, rdwr->nmsgs);
+	}
+	errno = EINVAL;
+	return -1;
+}
+
+ssize_t read(int fd, void *buf, size_t count)
+{
+	struct i2c_msg msg;
+
+	if (fd < 0 || fd >= SIM_MAX_FD || fds[fd].bus < 0)
+		return real_read(fd, buf, count);
+	msg.addr = fds[fd].addr;
+	msg.flags = I2C_M_RD;
+	msg.len = count > 8192 ? 8192 : count;
+	msg.buf = buf;
+	return sim_xfer(fds[fd].bus, &msg, 1) < 0 ? -1 : msg.len;
+}
+
+ssize_t write(int fd, const void *buf, size_t count)
+{
+	struct i2c_msg msg;
+
+	if (fd < 0 || fd >= SIM_MAX_FD || fds[fd].bus < 0)
+		return real_write(fd, buf, count);
+	msg.addr = fds[fd].addr;
+	msg.flags = 0;
+	msg.len = count > 8192 ? 8192 : count;
+	msg.buf = (uint8_t *)buf;
+	return sim_xfer(fds[fd].bus, &msg, 1) < 0 ? -1 : msg.len;
+}
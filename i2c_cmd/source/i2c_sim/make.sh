@@ -0,0 +1,3 @@
+
+${CC:-gcc} -shared -fPIC -O2 -I../i2c_tools -o libi2c_sim.so i2c_sim.c ../i2c_tools/cs_regmap.c -ldl -lpthread
+
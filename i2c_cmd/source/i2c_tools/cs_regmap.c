@@ -0,0 +1,57 @@
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "i2c_comm.h"
+
+/*
+ * CS-MIPI-IMX307 / CS-MIPI-SC132 register map. The table is generated from
+ * ../regmap/cs_regs.txt, multi byte values are grouped under the name without
+ * the _L/_M/_H/_E suffix.
+ */
+#define CS_REGS_TABLE
+#include "cs_regs.h"
+
+/* names match case insensitively and ignoring '_', "exptime" is EXP_TIME */
+static int cs_reg_namecmp(const char *a, const char *b)
+{
+	for (;;)
+	{
+		while (*a == '_')
+			a++;
+		while (*b == '_')
+			b++;
+		if (tolower((unsigned char)*a) != tolower((unsigned char)*b))
+			return 1;
+		if (*a == '\0')
+			return 0;
+		a++;
+		b++;
+	}
+}
+
+const struct reg_desc *cs_reg_find(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(cs_regs) / sizeof(cs_regs[0]); i++)
+	{
+		if (cs_reg_namecmp(cs_regs[i].name, name) == 0)
+			return &cs_regs[i];
+	}
+	return NULL;
+}
+
+/* find the group that contains addr */
+const struct reg_desc *cs_reg_at(uint16_t addr)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(cs_regs) / sizeof(cs_regs[0]); i++)
+	{
+		if (addr >= cs_regs[i].addr && addr < cs_regs[i].addr + cs_regs[i].width)
+			return &cs_regs[i];
+	}
+	return NULL;
+}
@@ -0,0 +1,242 @@
+/* generated by gen_regmap.sh from cs_regs.txt, do not edit */
+
+#ifndef _CS_REGS_H
+#define _CS_REGS_H
+
+#define CS_REG_DEVICEID                 0x00
+#define CS_REG_DEVICEID_WIDTH           1
+#define CS_REG_HARDWARE                 0x01
+#define CS_REG_HARDWARE_WIDTH           1
+#define CS_REG_LOADINGDONE              0x02
+#define CS_REG_LOADINGDONE_WIDTH        1
+#define CS_REG_CSI2_ENABLE              0x03
+#define CS_REG_CSI2_ENABLE_WIDTH        1
+#define CS_REG_CAM_CAP                  0x04
+#define CS_REG_CAM_CAP_WIDTH            2
+#define CS_REG_I2C_ADDR                 0x06
+#define CS_REG_I2C_ADDR_WIDTH           1
+#define CS_REG_STREAMMODE               0x0E
+#define CS_REG_STREAMMODE_WIDTH         1
+#define CS_REG_SLAVEMODE                0x0F
+#define CS_REG_SLAVEMODE_WIDTH          1
+#define CS_REG_STROBEIO_MODE            0x10
+#define CS_REG_STROBEIO_MODE_WIDTH      1
+#define CS_REG_STROBE_SEL               0x11
+#define CS_REG_STROBE_SEL_WIDTH         1
+#define CS_REG_STROBE_VALUE             0x12
+#define CS_REG_STROBE_VALUE_WIDTH       1
+#define CS_REG_TRIGGERIO_MODE           0x14
+#define CS_REG_TRIGGERIO_MODE_WIDTH     1
+#define CS_REG_TRIGGER_SEL              0x15
+#define CS_REG_TRIGGER_SEL_WIDTH        1
+#define CS_REG_TRIGGER_VALUE            0x16
+#define CS_REG_TRIGGER_VALUE_WIDTH      1
+#define CS_REG_EXTTRIGEDGE              0x18
+#define CS_REG_EXTTRIGEDGE_WIDTH        1
+#define CS_REG_EXTTRIGDEBOUNCEREN       0x19
+#define CS_REG_EXTTRIGDEBOUNCEREN_WIDTH 1
+#define CS_REG_EXTTRIGDEBOUNCERTIME     0x1A
+#define CS_REG_EXTTRIGDEBOUNCERTIME_WIDTH 3
+#define CS_REG_SOFTTRIG                 0x1D
+#define CS_REG_SOFTTRIG_WIDTH           1
+#define CS_REG_TRIGDLY                  0x1E
+#define CS_REG_TRIGDLY_WIDTH            4
+#define CS_REG_PICKMODEENABLE           0x26
+#define CS_REG_PICKMODEENABLE_WIDTH     1
+#define CS_REG_PICKONE                  0x27
+#define CS_REG_PICKONE_WIDTH            1
+#define CS_REG_DISCARDEDQNT             0x28
+#define CS_REG_DISCARDEDQNT_WIDTH       1
+#define CS_REG_AUTOTRIGCNTMAX           0xC7
+#define CS_REG_AUTOTRIGCNTMAX_WIDTH     3
+#define CS_REG_AUTOTRIGENABLE           0xCA
+#define CS_REG_AUTOTRIGENABLE_WIDTH     1
+#define CS_REG_MIPI_COUNT               0xCE
+#define CS_REG_MIPI_COUNT_WIDTH         2
+#define CS_REG_MIPI_STAT                0xD0
+#define CS_REG_MIPI_STAT_WIDTH          1
+#define CS_REG_ARM_VER                  0x0100
+#define CS_REG_ARM_VER_WIDTH            2
+#define CS_REG_PRODUCTID                0x0102
+#define CS_REG_PRODUCTID_WIDTH          2
+#define CS_REG_SYSTEM_RESET             0x0104
+#define CS_REG_SYSTEM_RESET_WIDTH       1
+#define CS_REG_PARAM_SAVE               0x0105
+#define CS_REG_PARAM_SAVE_WIDTH         1
+#define CS_REG_VIDEOFMT_CAP             0x0106
+#define CS_REG_VIDEOFMT_CAP_WIDTH       1
+#define CS_REG_VIDEOFMT_NUM             0x0107
+#define CS_REG_VIDEOFMT_NUM_WIDTH       1
+#define CS_REG_FMTCAP_WIDTH             0x0108
+#define CS_REG_FMTCAP_WIDTH_WIDTH       2
+#define CS_REG_FMTCAP_HEIGHT            0x010A
+#define CS_REG_FMTCAP_HEIGHT_WIDTH      2
+#define CS_REG_FMTCAP_FRAMRAT           0x010C
+#define CS_REG_FMTCAP_FRAMRAT_WIDTH     2
+#define CS_REG_FMT_WIDTH                0x0180
+#define CS_REG_FMT_WIDTH_WIDTH          2
+#define CS_REG_FMT_HEIGHT               0x0182
+#define CS_REG_FMT_HEIGHT_WIDTH         2
+#define CS_REG_FMT_FRAMRAT              0x0184
+#define CS_REG_FMT_FRAMRAT_WIDTH        2
+#define CS_REG_IMAGE_DIR                0x0186
+#define CS_REG_IMAGE_DIR_WIDTH          1
+#define CS_REG_SYSTEM_REBOOT            0x0187
+#define CS_REG_SYSTEM_REBOOT_WIDTH      1
+#define CS_REG_NEW_FMT_FRAMRAT_MODE     0x0188
+#define CS_REG_NEW_FMT_FRAMRAT_MODE_WIDTH 1
+#define CS_REG_NEW_FMT_FRAMRAT          0x0189
+#define CS_REG_NEW_FMT_FRAMRAT_WIDTH    2
+#define CS_REG_ISP_CAP                  0x0200
+#define CS_REG_ISP_CAP_WIDTH            4
+#define CS_REG_POWER_HZ                 0x0204
+#define CS_REG_POWER_HZ_WIDTH           1
+#define CS_REG_DAY_NIGHT_MODE           0x0205
+#define CS_REG_DAY_NIGHT_MODE_WIDTH     1
+#define CS_REG_CSC_HUE                  0x0206
+#define CS_REG_CSC_HUE_WIDTH            1
+#define CS_REG_CSC_CONTT                0x0207
+#define CS_REG_CSC_CONTT_WIDTH          1
+#define CS_REG_CSC_SATU                 0x0208
+#define CS_REG_CSC_SATU_WIDTH           1
+#define CS_REG_EXP_FRM_MODE             0x020F
+#define CS_REG_EXP_FRM_MODE_WIDTH       1
+#define CS_REG_AE_MODE                  0x0210
+#define CS_REG_AE_MODE_WIDTH            1
+#define CS_REG_EXP_TIME                 0x0211
+#define CS_REG_EXP_TIME_WIDTH           4
+#define CS_REG_AGAIN_NOW                0x0215
+#define CS_REG_AGAIN_NOW_WIDTH          2
+#define CS_REG_DGAIN_NOW                0x0217
+#define CS_REG_DGAIN_NOW_WIDTH          2
+#define CS_REG_AE_SPEED                 0x0219
+#define CS_REG_AE_SPEED_WIDTH           1
+#define CS_REG_AE_TARGET                0x021A
+#define CS_REG_AE_TARGET_WIDTH          1
+#define CS_REG_AE_MAXTIME               0x021B
+#define CS_REG_AE_MAXTIME_WIDTH         4
+#define CS_REG_AE_MAXGAIN               0x021F
+#define CS_REG_AE_MAXGAIN_WIDTH         2
+#define CS_REG_ME_TIME                  0x0226
+#define CS_REG_ME_TIME_WIDTH            4
+#define CS_REG_ME_AGAIN                 0x022A
+#define CS_REG_ME_AGAIN_WIDTH           2
+#define CS_REG_ME_DGAIN                 0x022C
+#define CS_REG_ME_DGAIN_WIDTH           2
+#define CS_REG_AE_SLOW_GAIN             0x022E
+#define CS_REG_AE_SLOW_GAIN_WIDTH       2
+#define CS_REG_AWB_MODE                 0x0230
+#define CS_REG_AWB_MODE_WIDTH           1
+#define CS_REG_WB_RGAIN                 0x0231
+#define CS_REG_WB_RGAIN_WIDTH           1
+#define CS_REG_WB_GGAIN                 0x0232
+#define CS_REG_WB_GGAIN_WIDTH           1
+#define CS_REG_WB_BGAIN                 0x0233
+#define CS_REG_WB_BGAIN_WIDTH           1
+#define CS_REG_WB_COLORTEMP             0x0235
+#define CS_REG_WB_COLORTEMP_WIDTH       2
+#define CS_REG_MWB_COLORTEMP            0x023A
+#define CS_REG_MWB_COLORTEMP_WIDTH      2
+#define CS_REG_MWB_RGAIN                0x023C
+#define CS_REG_MWB_RGAIN_WIDTH          1
+#define CS_REG_MWB_GGAIN                0x023D
+#define CS_REG_MWB_GGAIN_WIDTH          1
+#define CS_REG_MWB_BGAIN                0x023E
+#define CS_REG_MWB_BGAIN_WIDTH          1
+#define CS_REG_DME_TIME                 0x0240
+#define CS_REG_DME_TIME_WIDTH           4
+#define CS_REG_DME_AGAIN                0x0244
+#define CS_REG_DME_AGAIN_WIDTH          2
+#define CS_REG_DME_DGAIN                0x0246
+#define CS_REG_DME_DGAIN_WIDTH          2
+#define CS_REG_SNSOR_REG_FLG            0x0700
+#define CS_REG_SNSOR_REG_FLG_WIDTH      1
+#define CS_REG_SNSOR_REG_ADDR           0x0701
+#define CS_REG_SNSOR_REG_ADDR_WIDTH     2
+#define CS_REG_SNSOR_REG_VAL            0x0703
+#define CS_REG_SNSOR_REG_VAL_WIDTH      1
+
+#endif
+
+/* the table itself, only for the one file that defines CS_REGS_TABLE */
+#if defined(CS_REGS_TABLE) && !defined(_CS_REGS_TABLE)
+#define _CS_REGS_TABLE
+static const struct reg_desc cs_regs[] = {
+	{ "deviceID",              0x00, 1, REG_ACC_CONST },
+	{ "HardWare",              0x01, 1, REG_ACC_CONST },
+	{ "LoadingDone",           0x02, 1, REG_ACC_RO },
+	{ "Csi2_Enable",           0x03, 1, REG_ACC_RW },
+	{ "CAM_CAP",               0x04, 2, REG_ACC_CONST },
+	{ "I2c_addr",              0x06, 1, REG_ACC_RW },
+	{ "StreamMode",            0x0E, 1, REG_ACC_RW },
+	{ "SlaveMode",             0x0F, 1, REG_ACC_RW },
+	{ "StrobeIO_MODE",         0x10, 1, REG_ACC_RW },
+	{ "Strobe_sel",            0x11, 1, REG_ACC_RW },
+	{ "Strobe_value",          0x12, 1, REG_ACC_RW },
+	{ "TriggerIO_MODE",        0x14, 1, REG_ACC_RW },
+	{ "Trigger_sel",           0x15, 1, REG_ACC_RW },
+	{ "Trigger_value",         0x16, 1, REG_ACC_RW },
+	{ "ExtTrigEdge",           0x18, 1, REG_ACC_RW },
+	{ "ExtTrigDebouncerEn",    0x19, 1, REG_ACC_RW },
+	{ "ExtTrigDebouncerTime",  0x1A, 3, REG_ACC_RW },
+	{ "SoftTrig",              0x1D, 1, REG_ACC_CMD },
+	{ "TrigDly",               0x1E, 4, REG_ACC_RW },
+	{ "PickModeEnable",        0x26, 1, REG_ACC_RW },
+	{ "PickOne",               0x27, 1, REG_ACC_CMD },
+	{ "DiscardedQnt",          0x28, 1, REG_ACC_RW },
+	{ "AutoTrigCntMax",        0xC7, 3, REG_ACC_RW },
+	{ "AutoTrigEnable",        0xCA, 1, REG_ACC_RW },
+	{ "MIPI_COUNT",            0xCE, 2, REG_ACC_RO },
+	{ "MIPI_STAT",             0xD0, 1, REG_ACC_RO },
+	{ "ARM_VER",               0x0100, 2, REG_ACC_CONST },
+	{ "PRODUCTID",             0x0102, 2, REG_ACC_CONST },
+	{ "SYSTEM_RESET",          0x0104, 1, REG_ACC_CMD },
+	{ "PARAM_SAVE",            0x0105, 1, REG_ACC_CMD },
+	{ "VIDEOFMT_CAP",          0x0106, 1, REG_ACC_CONST },
+	{ "VIDEOFMT_NUM",          0x0107, 1, REG_ACC_CONST },
+	{ "FMTCAP_WIDTH",          0x0108, 2, REG_ACC_CONST },
+	{ "FMTCAP_HEIGHT",         0x010A, 2, REG_ACC_CONST },
+	{ "FMTCAP_FRAMRAT",        0x010C, 2, REG_ACC_CONST },
+	{ "FMT_WIDTH",             0x0180, 2, REG_ACC_RW },
+	{ "FMT_HEIGHT",            0x0182, 2, REG_ACC_RW },
+	{ "FMT_FRAMRAT",           0x0184, 2, REG_ACC_RW },
+	{ "IMAGE_DIR",             0x0186, 1, REG_ACC_RW },
+	{ "SYSTEM_REBOOT",         0x0187, 1, REG_ACC_CMD },
+	{ "NEW_FMT_FRAMRAT_MODE",  0x0188, 1, REG_ACC_RW },
+	{ "NEW_FMT_FRAMRAT",       0x0189, 2, REG_ACC_RW },
+	{ "ISP_CAP",               0x0200, 4, REG_ACC_CONST },
+	{ "POWER_HZ",              0x0204, 1, REG_ACC_RW },
+	{ "DAY_NIGHT_MODE",        0x0205, 1, REG_ACC_RW },
+	{ "CSC_HUE",               0x0206, 1, REG_ACC_RW },
+	{ "CSC_CONTT",             0x0207, 1, REG_ACC_RW },
+	{ "CSC_SATU",              0x0208, 1, REG_ACC_RW },
+	{ "EXP_FRM_MODE",          0x020F, 1, REG_ACC_RW },
+	{ "AE_MODE",               0x0210, 1, REG_ACC_RW },
+	{ "EXP_TIME",              0x0211, 4, REG_ACC_RO },
+	{ "AGAIN_NOW",             0x0215, 2, REG_ACC_RO },
+	{ "DGAIN_NOW",             0x0217, 2, REG_ACC_RO },
+	{ "AE_SPEED",              0x0219, 1, REG_ACC_RW },
+	{ "AE_TARGET",             0x021A, 1, REG_ACC_RW },
+	{ "AE_MAXTIME",            0x021B, 4, REG_ACC_RW },
+	{ "AE_MAXGAIN",            0x021F, 2, REG_ACC_RW },
+	{ "ME_TIME",               0x0226, 4, REG_ACC_RW },
+	{ "ME_AGAIN",              0x022A, 2, REG_ACC_RW },
+	{ "ME_DGAIN",              0x022C, 2, REG_ACC_RW },
+	{ "AE_SLOW_GAIN",          0x022E, 2, REG_ACC_RW },
+	{ "AWB_MODE",              0x0230, 1, REG_ACC_RW },
+	{ "WB_RGAIN",              0x0231, 1, REG_ACC_RO },
+	{ "WB_GGAIN",              0x0232, 1, REG_ACC_RO },
+	{ "WB_BGAIN",              0x0233, 1, REG_ACC_RO },
+	{ "WB_COLORTEMP",          0x0235, 2, REG_ACC_RO },
+	{ "MWB_COLORTEMP",         0x023A, 2, REG_ACC_RW },
+	{ "MWB_RGAIN",             0x023C, 1, REG_ACC_RW },
+	{ "MWB_GGAIN",             0x023D, 1, REG_ACC_RW },
+	{ "MWB_BGAIN",             0x023E, 1, REG_ACC_RW },
+	{ "DME_TIME",              0x0240, 4, REG_ACC_RW },
+	{ "DME_AGAIN",             0x0244, 2, REG_ACC_RW },
+	{ "DME_DGAIN",             0x0246, 2, REG_ACC_RW },
+	{ "SNSOR_REG_FLG",         0x0700, 1, REG_ACC_CMD },
+	{ "SNSOR_REG_ADDR",        0x0701, 2, REG_ACC_CMD },
+	{ "SNSOR_REG_VAL",         0x0703, 1, REG_ACC_CMD },
+};
+#endif
@@ -0,0 +1,391 @@
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "i2c_comm.h"
+
+/*
+ * Opt-in shadow cache for the register tools, enabled with I2C_REGCACHE=1
+ * in the environment (I2C_REGCACHE=v also prints what was saved at exit).
+ *
+ * One file per bus and device address under REGCACHE_DIR keeps the last
+ * known value of every register, so it survives across the one-shot tool
+ * invocations of the shell scripts. What may be cached comes from the
+ * register map:
+ *   const  reads are served from the cache once known
+ *   rw     writes of the value the register already holds are dropped
+ *   ro/cmd never cached, as is anything outside the map
+ * A write to SYSTEM_RESET, SYSTEM_REBOOT or I2c_addr forgets everything
+ * known about the device. The cache only sees what goes through these
+ * tools; after touching the camera any other way, delete the file.
+ *
+ * The map is that of the CS cameras, and other cameras sit at the same
+ * address (the VEYE ones at 0x3b too). So a device is left alone until a
+ * read of PRODUCTID through the tools returned a CS product id, e.g.
+ * "i2c_read <bus> 0x3b PRODUCTID" once; the file remembers it. 0x10-0x14
+ * are never cached either, on a VEYE camera they are the ISP command
+ * window and a repeated write there is a new command.
+ *
+ * The per process state is safe to use from several threads as long as
+ * each thread uses its own bus fd (see struct regcache_bus); the counters
+ * are updated atomically and the file itself is serialised with flock.
+ */
+
+#define REGCACHE_DIR		"/run/i2c_regcache"
+#define REGCACHE_MAGIC		0x43524543	/* "CERC" */
+#define REGCACHE_MAX_FD		256
+#define REGCACHE_MAX_DEV	8
+
+/* product ids of the CS cameras, as read from PRODUCTID */
+static const uint16_t regcache_products[] = {
+	0x0037, 0x0038, 0x0039,		/* MIPI, LVDS, USB IMX307 */
+	0x0132, 0x0133, 0x0134,		/* MIPI, LVDS, USB SC132 */
+};
+
+/* the VEYE ISP command window, see regmap/veye_regs.txt */
+#define REGCACHE_VEYE_ISP_FIRST	0x10
+#define REGCACHE_VEYE_ISP_LAST	0x14
+
+struct regcache_file {
+	uint32_t magic;
+	uint32_t size;
+	unsigned long long reads_saved;
+	unsigned long long writes_saved;
+	uint32_t product;	/* PRODUCTID seen, 0 while not identified */
+	uint32_t is_cs;		/* product is a CS camera */
+	uint8_t valid[0x10000 / 8];
+	uint8_t val[0x10000];
+};
+
+struct regcache_dev {
+	uint8_t i2c_addr;
+	int fd;
+	struct regcache_file *map;
+};
+
+/* per bus fd, each slot is only touched by the thread owning that fd */
+struct regcache_bus {
+	int bus;
+	int num_devs;
+	struct regcache_dev devs[REGCACHE_MAX_DEV];
+};
+
+static struct regcache_bus buses[REGCACHE_MAX_FD];
+static int regcache_mode = -1;	/* -1 not checked yet, 0 off, 1 on, 2 verbose */
+static unsigned long long reads_saved, writes_saved;
+
+static void regcache_report(void)
+{
+	int i, j;
+
+	fprintf(stderr, "regcache: saved %llu reads, %llu register writes\n",
+		__atomic_load_n(&reads_saved, __ATOMIC_RELAXED),
+		__atomic_load_n(&writes_saved, __ATOMIC_RELAXED));
+	for (i = 0; i < REGCACHE_MAX_FD; i++)
+	{
+		for (j = 0; j < buses[i].num_devs; j++)
+			fprintf(stderr, "regcache: i2c-%d %#x total saved %llu reads, %llu register writes\n",
+				buses[i].bus, buses[i].devs[j].i2c_addr,
+				buses[i].devs[j].map->reads_saved, buses[i].devs[j].map->writes_saved);
+	}
+}
+
+static int regcache_enabled(void)
+{
+	const char *env;
+	int mode, unset = -1;
+
+	mode = __atomic_load_n(&regcache_mode, __ATOMIC_ACQUIRE);
+	if (mode < 0)
+	{
+		env = getenv("I2C_REGCACHE");
+		mode = 0;
+		if (env != NULL && env[0] == 'v')
+			mode = 2;
+		else if (env != NULL && env[0] != '\0' && env[0] != '0')
+			mode = 1;
+		/* the first thread to get here decides, and registers the report */
+		if (__atomic_compare_exchange_n(&regcache_mode, &unset, mode, 0,
+						__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		{
+			if (mode == 2)
+				atexit(regcache_report);
+		}
+		else
+		{
+			mode = unset;
+		}
+	}
+	return mode > 0;
+}
+
+void regcache_attach(int fd, U32 bus)
+{
+	if (!regcache_enabled() || fd < 0 || fd >= REGCACHE_MAX_FD)
+		return;
+	/* a reused fd number may still carry the mappings of a closed bus */
+	while (buses[fd].num_devs > 0)
+	{
+		buses[fd].num_devs--;
+		munmap(buses[fd].devs[buses[fd].num_devs].map, sizeof(struct regcache_file));
+		close(buses[fd].devs[buses[fd].num_devs].fd);
+	}
+	buses[fd].bus = bus;
+}
+
+static struct regcache_file *regcache_get(int fd, uint8_t i2c_addr, int *lock_fd)
+{
+	struct regcache_bus *b;
+	struct regcache_dev *d;
+	char path[64];
+	int i, cfd;
+	void *map;
+
+	if (!regcache_enabled() || fd < 0 || fd >= REGCACHE_MAX_FD)
+		return NULL;
+	b = &buses[fd];
+	for (i = 0; i < b->num_devs; i++)
+	{
+		if (b->devs[i].i2c_addr == i2c_addr)
+		{
+			*lock_fd = b->devs[i].fd;
+			flock(*lock_fd, LOCK_EX);
+			return b->devs[i].map;
+		}
+	}
+	if (b->num_devs == REGCACHE_MAX_DEV)
+		return NULL;
+
+	mkdir(REGCACHE_DIR, 0755);
+	snprintf(path, sizeof(path), REGCACHE_DIR "/i2c-%d-%02x", b->bus, i2c_addr);
+	cfd = open(path, O_RDWR | O_CREAT, 0644);
+	if (cfd < 0)
+		return NULL;
+	flock(cfd, LOCK_EX);
+	/* a new or foreign file starts out empty, ftruncate zero fills it */
+	if (ftruncate(cfd, sizeof(struct regcache_file)) < 0)
+		goto err;
+	map = mmap(NULL, sizeof(struct regcache_file), PROT_READ | PROT_WRITE, MAP_SHARED, cfd, 0);
+	if (map == MAP_FAILED)
+		goto err;
+
+	d = &b->devs[b->num_devs++];
+	d->i2c_addr = i2c_addr;
+	d->fd = cfd;
+	d->map = map;
+	if (d->map->magic != REGCACHE_MAGIC || d->map->size != sizeof(struct regcache_file))
+	{
+		memset(d->map, 0, sizeof(struct regcache_file));
+		d->map->magic = REGCACHE_MAGIC;
+		d->map->size = sizeof(struct regcache_file);
+	}
+	*lock_fd = cfd;
+	return d->map;
+
+err:
+	flock(cfd, LOCK_UN);
+	close(cfd);
+	return NULL;
+}
+
+static void regcache_put(int lock_fd)
+{
+	flock(lock_fd, LOCK_UN);
+}
+
+static int regcache_access(uint16_t reg)
+{
+	const struct reg_desc *desc;
+
+	if (reg >= REGCACHE_VEYE_ISP_FIRST && reg <= REGCACHE_VEYE_ISP_LAST)
+		return REG_ACC_CMD;
+	desc = cs_reg_at(reg);
+	return desc ? desc->access : REG_ACC_CMD;
+}
+
+/* look at a read that covered PRODUCTID, returns whether c is a CS camera */
+static int regcache_identify(struct regcache_file *c, uint16_t reg, const uint8_t *values, uint32_t n)
+{
+	uint32_t id, i;
+
+	if (reg <= CS_REG_PRODUCTID && reg + n >= CS_REG_PRODUCTID + CS_REG_PRODUCTID_WIDTH)
+	{
+		id = values[CS_REG_PRODUCTID - reg] | values[CS_REG_PRODUCTID + 1 - reg] << 8;
+		if (id != c->product)
+		{
+			/* a different camera, nothing known so far holds */
+			memset(c->valid, 0, sizeof(c->valid));
+			c->product = id;
+			c->is_cs = 0;
+			for (i = 0; i < sizeof(regcache_products) / sizeof(regcache_products[0]); i++)
+			{
+				if (regcache_products[i] == id)
+					c->is_cs = 1;
+			}
+		}
+	}
+	return c->is_cs;
+}
+
+static int regcache_valid(const struct regcache_file *c, uint16_t reg)
+{
+	return c->valid[reg >> 3] & (1 << (reg & 7));
+}
+
+/* serve a read of n registers from the cache, returns 1 when it could */
+int regcache_read(int fd, uint8_t i2c_addr, uint16_t reg, uint8_t *values, uint32_t n)
+{
+	struct regcache_file *c;
+	int lock_fd;
+	uint32_t i;
+
+	if (reg + n > 0x10000)
+		return 0;
+	c = regcache_get(fd, i2c_addr, &lock_fd);
+	if (c == NULL)
+		return 0;
+	if (!c->is_cs)
+	{
+		regcache_put(lock_fd);
+		return 0;
+	}
+	for (i = 0; i < n; i++)
+	{
+		if (regcache_access(reg + i) != REG_ACC_CONST || !regcache_valid(c, reg + i))
+		{
+			regcache_put(lock_fd);
+			return 0;
+		}
+	}
+	memcpy(values, c->val + reg, n);
+	c->reads_saved++;
+	__atomic_fetch_add(&reads_saved, 1, __ATOMIC_RELAXED);
+	regcache_put(lock_fd);
+	return 1;
+}
+
+/* remember what the bus returned for a read of n registers */
+void regcache_fill(int fd, uint8_t i2c_addr, uint16_t reg, const uint8_t *values, uint32_t n)
+{
+	struct regcache_file *c;
+	int lock_fd, acc;
+	uint32_t i;
+
+	c = regcache_get(fd, i2c_addr, &lock_fd);
+	if (c == NULL)
+		return;
+	if (!regcache_identify(c, reg, values, n))
+	{
+		regcache_put(lock_fd);
+		return;
+	}
+	for (i = 0; i < n && reg + i < 0x10000; i++)
+	{
+		acc = regcache_access(reg + i);
+		if (acc != REG_ACC_CONST && acc != REG_ACC_RW)
+			continue;
+		c->val[reg + i] = values[i];
+		c->valid[(reg + i) >> 3] |= 1 << ((reg + i) & 7);
+	}
+	regcache_put(lock_fd);
+}
+
+/*
+ * look at the write regs[0], returns how many entries form its register
+ * group (all consecutive bytes of one multi byte value, or 1) and sets
+ * *redundant when the whole group already holds those values. A group is
+ * only ever dropped as a whole, the firmware may latch it on the last byte.
+ */
+int regcache_filter(int fd, uint8_t i2c_addr, const struct sensor_regs *regs, int num, int *redundant)
+{
+	const struct reg_desc *desc = cs_reg_at(regs[0].reg);
+	struct regcache_file *c;
+	int lock_fd, cnt, i;
+
+	*redundant = 0;
+	cnt = 1;
+	if (desc != NULL && desc->width > 1)
+	{
+		while (cnt < num && regs[cnt].reg == regs[0].reg + cnt &&
+		       regs[cnt].reg < desc->addr + desc->width)
+			cnt++;
+	}
+	if (desc == NULL || desc->access != REG_ACC_RW ||
+	    (desc->width > 1 && (regs[0].reg != desc->addr || cnt != desc->width)))
+		return cnt;
+
+	c = regcache_get(fd, i2c_addr, &lock_fd);
+	if (c == NULL)
+		return cnt;
+	if (!c->is_cs)
+	{
+		regcache_put(lock_fd);
+		return cnt;
+	}
+	for (i = 0; i < cnt; i++)
+	{
+		if (!regcache_valid(c, regs[i].reg) || c->val[regs[i].reg] != (regs[i].data & 0xff))
+			break;
+	}
+	if (i == cnt)
+	{
+		*redundant = 1;
+		c->writes_saved += cnt;
+		__atomic_fetch_add(&writes_saved, cnt, __ATOMIC_RELAXED);
+	}
+	regcache_put(lock_fd);
+	return cnt;
+}
+
+/* a write is queued for the bus, update or invalidate */
+void regcache_written(int fd, uint8_t i2c_addr, uint16_t reg, uint8_t value)
+{
+	struct regcache_file *c;
+	int lock_fd, acc;
+
+	c = regcache_get(fd, i2c_addr, &lock_fd);
+	if (c == NULL)
+		return;
+	if (!c->is_cs)
+	{
+		regcache_put(lock_fd);
+		return;
+	}
+	if (reg == CS_REG_SYSTEM_RESET || reg == CS_REG_SYSTEM_REBOOT || reg == CS_REG_I2C_ADDR)
+	{
+		memset(c->valid, 0, sizeof(c->valid));
+		/* the camera moves away, whatever answers here next is unknown */
+		if (reg == CS_REG_I2C_ADDR)
+			c->product = c->is_cs = 0;
+	}
+	else
+	{
+		acc = regcache_access(reg);
+		if (acc == REG_ACC_RW)
+		{
+			c->val[reg] = value;
+			c->valid[reg >> 3] |= 1 << (reg & 7);
+		}
+	}
+	regcache_put(lock_fd);
+}
+
+/* forget everything known about a device */
+void regcache_invalidate(int fd, uint8_t i2c_addr)
+{
+	struct regcache_file *c;
+	int lock_fd;
+
+	c = regcache_get(fd, i2c_addr, &lock_fd);
+	if (c == NULL)
+		return;
+	memset(c->valid, 0, sizeof(c->valid));
+	regcache_put(lock_fd);
+}
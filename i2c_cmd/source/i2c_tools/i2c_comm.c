@@ -0,0 +1,393 @@
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "i2c_comm.h"
+
+/*
+ * Shared I2C helpers for the register tools. Every register on the CS and
+ * VEYE cameras is one byte behind a 16 bit big endian register address.
+ */
+
+int i2c_open_bus(U32 bus)
+{
+	char name[I2C_DEVICE_NAME_LEN];
+	int fd;
+
+	snprintf(name, sizeof(name), "/dev/i2c-%d", bus);
+	fd = open(name, O_RDWR);
+	if (fd < 0)
+	{
+		printf("Couldn't open I2C device %s\n", name);
+		return -1;
+	}
+	regcache_attach(fd, bus);
+	return fd;
+}
+
+/* read n consecutive registers with one repeated-start transaction */
+int i2c_read_regs(int fd, uint8_t i2c_addr, uint16_t reg, uint8_t *values, uint32_t n)
+{
+	uint8_t buf[2] = { reg >> 8, reg & 0xff };
+	struct i2c_rdwr_ioctl_data msgset;
+	struct i2c_msg msgs[2] = {
+		{
+			.addr = i2c_addr,
+			.flags = 0,
+			.len = 2,
+			.buf = buf,
+		},
+		{
+			.addr = i2c_addr,
+			.flags = I2C_M_RD,
+			.len = n,
+			.buf = values,
+		},
+	};
+
+	msgset.msgs = msgs;
+	msgset.nmsgs = 2;
+
+	if (regcache_read(fd, i2c_addr, reg, values, n))
+		return 0;
+	if (ioctl(fd, I2C_RDWR, &msgset) != (int)msgset.nmsgs)
+		return -1;
+	regcache_fill(fd, i2c_addr, reg, values, n);
+	return 0;
+}
+
+/*
+ * read n consecutive registers in chunks of at most chunk bytes, for
+ * adapters that cannot do long reads. Up to I2C_RDWR_IOCTL_MAX_MSGS / 2
+ * chunks are packed into one ioctl.
+ */
+int i2c_read_burst(int fd, uint8_t i2c_addr, uint16_t reg, uint8_t *values, uint32_t n, uint32_t chunk)
+{
+	struct i2c_rdwr_ioctl_data msgset;
+	struct i2c_msg msgs[I2C_RDWR_IOCTL_MAX_MSGS];
+	uint8_t bufs[I2C_RDWR_IOCTL_MAX_MSGS / 2][2];
+	uint32_t off = 0, len, cnt = 0;
+
+	if (regcache_read(fd, i2c_addr, reg, values, n))
+		return 0;
+	if (chunk == 0)
+		chunk = n;
+	while (off < n)
+	{
+		len = n - off < chunk ? n - off : chunk;
+		bufs[cnt / 2][0] = (reg + off) >> 8;
+		bufs[cnt / 2][1] = (reg + off) & 0xff;
+		msgs[cnt].addr = i2c_addr;
+		msgs[cnt].flags = 0;
+		msgs[cnt].len = 2;
+		msgs[cnt].buf = bufs[cnt / 2];
+		cnt++;
+		msgs[cnt].addr = i2c_addr;
+		msgs[cnt].flags = I2C_M_RD;
+		msgs[cnt].len = len;
+		msgs[cnt].buf = values + off;
+		cnt++;
+		off += len;
+		if (cnt + 2 > I2C_RDWR_IOCTL_MAX_MSGS || off == n)
+		{
+			msgset.msgs = msgs;
+			msgset.nmsgs = cnt;
+			if (ioctl(fd, I2C_RDWR, &msgset) != (int)cnt)
+				return -1;
+			cnt = 0;
+		}
+	}
+	regcache_fill(fd, i2c_addr, reg, values, n);
+	return 0;
+}
+
+/*
+ * write n consecutive registers. Register writes are not assumed to auto
+ * increment, so every byte is its own message, send_regs packs them into
+ * as few I2C_RDWR ioctls as the kernel allows.
+ */
+int i2c_write_regs(int fd, uint8_t i2c_addr, uint16_t reg, const uint8_t *values, uint32_t n)
+{
+	struct sensor_regs *regs;
+	uint32_t i;
+	int ret;
+
+	regs = malloc(n * sizeof(*regs));
+	if (regs == NULL)
+		return -1;
+	for (i = 0; i < n; i++)
+	{
+		regs[i].reg = reg + i;
+		regs[i].data = values[i];
+	}
+	ret = send_regs(fd, i2c_addr, regs, n);
+	free(regs);
+	return ret < 0 ? -1 : 0;
+}
+
+static int i2c_flush_msgs(int fd, struct i2c_msg *msgs, uint32_t *cnt, uint32_t *xfers)
+{
+	struct i2c_rdwr_ioctl_data msgset;
+
+	if (*cnt == 0)
+		return 0;
+	msgset.msgs = msgs;
+	msgset.nmsgs = *cnt;
+	if (ioctl(fd, I2C_RDWR, &msgset) != (int)*cnt)
+	{
+		/* the cache already took the queued values, no telling what landed */
+		regcache_invalidate(fd, msgs[0].addr);
+		return -1;
+	}
+	*cnt = 0;
+	(*xfers)++;
+	return 0;
+}
+
+/*
+ * run a register script. Consecutive writes are coalesced into multi message
+ * I2C_RDWR ioctls; REG_OP_ADDR switches the device address, REG_OP_DELAY
+ * sleeps data us and REG_OP_REGWIDTH selects 1 or 2 byte register addresses
+ * (the fpdlink3 serdes use 8 bit ones). Returns the number of ioctls issued.
+ */
+int send_regs(int fd, uint8_t i2c_addr, const struct sensor_regs *regs, int num_regs)
+{
+	struct i2c_msg msgs[I2C_RDWR_IOCTL_MAX_MSGS];
+	uint8_t bufs[I2C_RDWR_IOCTL_MAX_MSGS][3];
+	uint32_t cnt = 0, xfers = 0, reg_width = 2;
+	int i, j = 0, redundant;
+
+	for (i = 0; i < num_regs; i++)
+	{
+		if (regs[i].reg == REG_OP_ADDR || regs[i].reg == REG_OP_DELAY ||
+		    regs[i].reg == REG_OP_REGWIDTH)
+		{
+			if (i2c_flush_msgs(fd, msgs, &cnt, &xfers) < 0)
+			{
+				printf("Failed to write registers before index %d\n", i);
+				return -1;
+			}
+			if (regs[i].reg == REG_OP_ADDR)
+				i2c_addr = regs[i].data;
+			else if (regs[i].reg == REG_OP_DELAY)
+				usleep(regs[i].data);
+			else
+				reg_width = regs[i].data == 1 ? 1 : 2;
+			continue;
+		}
+
+		/* only 16 bit register devices are cached, drop a whole group at once */
+		if (reg_width == 2 && j == 0)
+		{
+			j = regcache_filter(fd, i2c_addr, &regs[i], num_regs - i, &redundant);
+			if (redundant)
+			{
+				i += j - 1;
+				j = 0;
+				continue;
+			}
+		}
+		if (j > 0)
+			j--;
+
+		if (reg_width == 2)
+		{
+			bufs[cnt][0] = regs[i].reg >> 8;
+			bufs[cnt][1] = regs[i].reg & 0xff;
+			bufs[cnt][2] = regs[i].data;
+			regcache_written(fd, i2c_addr, regs[i].reg, regs[i].data);
+		}
+		else
+		{
+			bufs[cnt][0] = regs[i].reg & 0xff;
+			bufs[cnt][1] = regs[i].data;
+		}
+		msgs[cnt].addr = i2c_addr;
+		msgs[cnt].flags = 0;
+		msgs[cnt].len = reg_width + 1;
+		msgs[cnt].buf = bufs[cnt];
+		cnt++;
+		if (cnt == I2C_RDWR_IOCTL_MAX_MSGS && i2c_flush_msgs(fd, msgs, &cnt, &xfers) < 0)
+		{
+			printf("Failed to write registers up to index %d\n", i);
+			return -1;
+		}
+	}
+	if (i2c_flush_msgs(fd, msgs, &cnt, &xfers) < 0)
+	{
+		printf("Failed to write registers up to index %d\n", num_regs - 1);
+		return -1;
+	}
+	return xfers;
+}
+
+/*
+ * parse a register script into a sensor_regs list. One "<reg> <value>" pair
+ * per line, C initializer lines like "{0x0180, 0x80}," work as well, and a
+ * register map name in place of reg expands to its bytes little endian.
+ * Everything after '#' or "//" is a comment. Returns the entry count.
+ */
+int load_regs(FILE *fp, struct sensor_regs **regs)
+{
+	struct sensor_regs *list = NULL, *tmp;
+	const struct reg_desc *desc;
+	CHAR line[256];
+	CHAR *tok[2], *p, *save;
+	U32 reg, value, width, i;
+	int num = 0, size = 0, lineno = 0;
+
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		lineno++;
+		if ((p = strchr(line, '#')) != NULL)
+			*p = '\0';
+		if ((p = strstr(line, "//")) != NULL)
+			*p = '\0';
+		tok[0] = strtok_r(line, " \t\r\n{},;", &save);
+		if (tok[0] == NULL)
+			continue;
+		tok[1] = strtok_r(NULL, " \t\r\n{},;", &save);
+		if (tok[1] == NULL || StrToNumber(tok[1], &value) != HI_SUCCESS)
+		{
+			printf("line %d: bad value\n", lineno);
+			goto err;
+		}
+
+		if (StrToNumber(tok[0], &reg) == HI_SUCCESS)
+		{
+			/* only the pseudo registers take more than a byte */
+			if (reg > 0xFFFF || value > (reg >= REG_OP_REGWIDTH ? 0xFFFF : 0xFF))
+			{
+				printf("line %d: out of range\n", lineno);
+				goto err;
+			}
+			width = 1;
+		}
+		else if ((desc = cs_reg_find(tok[0])) != NULL)
+		{
+			reg = desc->addr;
+			width = desc->width;
+			if (width < 4 && (value >> (8 * width)) != 0)
+			{
+				printf("line %d: %#x does not fit in %s\n", lineno, value, tok[0]);
+				goto err;
+			}
+		}
+		else
+		{
+			printf("line %d: unknown register %s\n", lineno, tok[0]);
+			goto err;
+		}
+
+		if (num + (int)width > size)
+		{
+			size = size ? size * 2 : 64;
+			tmp = realloc(list, size * sizeof(*list));
+			if (tmp == NULL)
+				goto err;
+			list = tmp;
+		}
+		if (width == 1)
+		{
+			list[num].reg = reg;
+			list[num++].data = value;
+			continue;
+		}
+		for (i = 0; i < width; i++)
+		{
+			list[num].reg = reg + i;
+			list[num++].data = (value >> (8 * i)) & 0xFF;
+		}
+	}
+	*regs = list;
+	return num;
+
+err:
+	free(list);
+	return -1;
+}
+
+/*
+ * indirect sensor register access, with the handshake of read_senreg in
+ * cs_mipi_i2c.sh: SNSOR_REG_FLG is armed with 0, the address goes to
+ * SNSOR_REG_ADDR_L/H, and after the firmware had its settle time the flag
+ * reads 0xFF if the sensor did not answer, anything else means
+ * SNSOR_REG_VAL holds the value. The flag does not signal completion, so
+ * the settle time is a fixed wait.
+ *
+ * The firmware's request code for writes is not documented. Writes are
+ * only done when SENREG_WRITE_ENV holds that code, the flag is armed with
+ * it after SNSOR_REG_VAL was loaded.
+ */
+#define SENREG_REQ_READ		0x00
+#define SENREG_FLG_FAIL		0xFF
+#define SENREG_SETTLE_US	10000
+
+static int senreg_write_code(void)
+{
+	const char *env = getenv(SENREG_WRITE_ENV);
+	U32 code;
+
+	if (env == NULL || StrToNumber((CHAR *)env, &code) != HI_SUCCESS ||
+	    code > 0xFF || code == SENREG_REQ_READ || code == SENREG_FLG_FAIL)
+		return -1;
+	return code;
+}
+
+/*
+ * run num sensor register reads and writes back to back, each as one write
+ * ioctl for the request and one read of flag and value after the settle
+ * time. Writes fail unless enabled, see above.
+ * Returns the number of failed accesses, or -1 on a bus error.
+ */
+int senreg_xfer(int fd, uint8_t i2c_addr, struct senreg_op *ops, int num)
+{
+	int write_code = senreg_write_code();
+	struct sensor_regs req[4];
+	uint8_t st[4];		/* FLG, ADDR_L, ADDR_H, VAL */
+	int i, n, failed = 0;
+
+	for (i = 0; i < num; i++)
+	{
+		ops[i].ret = -1;
+		if (ops[i].write && write_code < 0)
+		{
+			failed++;
+			continue;
+		}
+		n = 0;
+		if (ops[i].write)
+		{
+			req[n].reg = CS_REG_SNSOR_REG_VAL;
+			req[n++].data = ops[i].value;
+		}
+		req[n].reg = CS_REG_SNSOR_REG_FLG;
+		req[n++].data = ops[i].write ? write_code : SENREG_REQ_READ;
+		req[n].reg = CS_REG_SNSOR_REG_ADDR;
+		req[n++].data = ops[i].addr & 0xff;
+		req[n].reg = CS_REG_SNSOR_REG_ADDR + 1;
+		req[n++].data = ops[i].addr >> 8;
+		if (send_regs(fd, i2c_addr, req, n) < 0)
+			return -1;
+
+		usleep(SENREG_SETTLE_US);
+		if (i2c_read_regs(fd, i2c_addr, CS_REG_SNSOR_REG_FLG, st, sizeof(st)) < 0)
+			return -1;
+		if (st[0] == SENREG_FLG_FAIL)
+		{
+			failed++;
+			continue;
+		}
+		ops[i].ret = 0;
+		if (!ops[i].write)
+			ops[i].value = st[3];
+	}
+	return failed;
+}
@@ -23,7 +23,59 @@ struct sensor_regs {
 	uint16_t data;
 };
 
+/* pseudo registers understood by send_regs */
+#define REG_OP_ADDR	0xFFFF	/* data: new 7 bit device address */
+#define REG_OP_DELAY	0xFFFE	/* data: delay in us */
+#define REG_OP_REGWIDTH	0xFFFD	/* data: register address bytes, 1 or 2 */
+
+#define I2C_DEVICE_NAME_LEN 13	// "/dev/i2c-XXX"+NULL
+
+/* holds the firmware's sensor register write code, writes are off without it */
+#define SENREG_WRITE_ENV	"I2C_SENREG_WRITE"
+
+/* one indirect sensor register access through the SNSOR_REG window */
+struct senreg_op {
+	uint16_t addr;		/* sensor register */
+	uint8_t value;		/* written, or what was read */
+	uint8_t write;
+	int ret;		/* 0 done, -1 failed or timed out */
+};
+
+/* register access class, drives what the tools may read, write or restore */
+#define REG_ACC_CONST	0	/* read only, never changes after power up */
+#define REG_ACC_RO	1	/* read only status, changes at runtime */
+#define REG_ACC_RW	2	/* configuration */
+#define REG_ACC_CMD	3	/* command or handshake, has side effects */
+
+/* a named register group, width bytes little endian starting at addr */
+struct reg_desc {
+	const char *name;
+	uint16_t addr;
+	uint8_t width;
+	uint8_t access;
+};
+
 HI_RET StrToNumber(IN CHAR *str , OUT U32 * pulValue);
 
+int i2c_open_bus(U32 bus);
+int i2c_read_regs(int fd, uint8_t i2c_addr, uint16_t reg, uint8_t *values, uint32_t n);
+int i2c_read_burst(int fd, uint8_t i2c_addr, uint16_t reg, uint8_t *values, uint32_t n, uint32_t chunk);
+int i2c_write_regs(int fd, uint8_t i2c_addr, uint16_t reg, const uint8_t *values, uint32_t n);
+int send_regs(int fd, uint8_t i2c_addr, const struct sensor_regs *regs, int num_regs);
+int load_regs(FILE *fp, struct sensor_regs **regs);
+int senreg_xfer(int fd, uint8_t i2c_addr, struct senreg_op *ops, int num);
+
+void regcache_attach(int fd, U32 bus);
+int regcache_read(int fd, uint8_t i2c_addr, uint16_t reg, uint8_t *values, uint32_t n);
+void regcache_fill(int fd, uint8_t i2c_addr, uint16_t reg, const uint8_t *values, uint32_t n);
+int regcache_filter(int fd, uint8_t i2c_addr, const struct sensor_regs *regs, int num, int *redundant);
+void regcache_written(int fd, uint8_t i2c_addr, uint16_t reg, uint8_t value);
+void regcache_invalidate(int fd, uint8_t i2c_addr);
+
+const struct reg_desc *cs_reg_find(const char *name);
+const struct reg_desc *cs_reg_at(uint16_t addr);
+
+#include "cs_regs.h"
+
 #endif
 
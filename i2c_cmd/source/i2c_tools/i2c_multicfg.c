@@ -0,0 +1,196 @@
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "i2c_comm.h"
+
+/*
+ * i2c_multicfg - configure several cameras at once.
+ *
+ * The manifest has one camera per line:
+ *   <bus> <device address> <profile script>
+ * where the profile is a register script as taken by i2c_write -f. Cameras
+ * on different buses are programmed concurrently by one worker per bus,
+ * cameras sharing a bus run in manifest order. '#' starts a comment.
+ */
+
+#define MULTICFG_MAX_CAMS	32
+#define MULTICFG_PATH_LEN	256
+
+struct multicfg_cam {
+	U32 bus;
+	U32 dev_addr;
+	CHAR profile[MULTICFG_PATH_LEN];
+	int num_regs;
+	int xfers;
+	int ret;
+	long usecs;
+};
+
+struct multicfg_bus {
+	U32 bus;
+	pthread_t thread;
+	struct multicfg_cam *cams[MULTICFG_MAX_CAMS];
+	int num_cams;
+};
+
+static struct multicfg_cam cams[MULTICFG_MAX_CAMS];
+static struct multicfg_bus buses[MULTICFG_MAX_CAMS];
+
+static long multicfg_usecs(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000000L + (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+static int multicfg_run_cam(int fd, struct multicfg_cam *cam)
+{
+	struct sensor_regs *regs = NULL;
+	FILE *fp;
+
+	fp = fopen(cam->profile, "r");
+	if (fp == NULL)
+		return -1;
+	cam->num_regs = load_regs(fp, &regs);
+	fclose(fp);
+	if (cam->num_regs < 0)
+		return -1;
+	cam->xfers = send_regs(fd, cam->dev_addr, regs, cam->num_regs);
+	free(regs);
+	return cam->xfers < 0 ? -1 : 0;
+}
+
+/* one worker per adapter, owns the bus fd for all cameras on it */
+static void *multicfg_worker(void *arg)
+{
+	struct multicfg_bus *b = arg;
+	struct timespec start;
+	int fd, i;
+
+	fd = i2c_open_bus(b->bus);
+	for (i = 0; i < b->num_cams; i++)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		b->cams[i]->ret = fd < 0 ? -1 : multicfg_run_cam(fd, b->cams[i]);
+		b->cams[i]->usecs = multicfg_usecs(&start);
+	}
+	if (fd >= 0)
+		close(fd);
+	return NULL;
+}
+
+static int multicfg_load(const CHAR *path)
+{
+	CHAR line[MULTICFG_PATH_LEN + 64];
+	CHAR *tok[3], *p, *save;
+	int num = 0, lineno = 0;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+	{
+		printf("Couldn't open manifest %s\n", path);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		lineno++;
+		if ((p = strchr(line, '#')) != NULL)
+			*p = '\0';
+		tok[0] = strtok_r(line, " \t\r\n", &save);
+		if (tok[0] == NULL)
+			continue;
+		tok[1] = strtok_r(NULL, " \t\r\n", &save);
+		tok[2] = strtok_r(NULL, " \t\r\n", &save);
+		if (num == MULTICFG_MAX_CAMS)
+		{
+			printf("line %d: more than %d cameras\n", lineno, MULTICFG_MAX_CAMS);
+			goto err;
+		}
+		if (tok[2] == NULL || StrToNumber(tok[0], &cams[num].bus) != HI_SUCCESS ||
+		    StrToNumber(tok[1], &cams[num].dev_addr) != HI_SUCCESS || cams[num].dev_addr > 0x7F)
+		{
+			printf("line %d: expected <bus> <device address> <profile>\n", lineno);
+			goto err;
+		}
+		snprintf(cams[num].profile, sizeof(cams[num].profile), "%s", tok[2]);
+		cams[num].ret = -1;
+		num++;
+	}
+	fclose(fp);
+	return num;
+
+err:
+	fclose(fp);
+	return -1;
+}
+
+int main(int argc, char *argv[])
+{
+	struct timespec start;
+	int num_cams, num_buses = 0, i, j, failed = 0;
+	long total;
+
+	if (argc < 2)
+	{
+		printf("usage: %s <manifest>. manifest lines: <bus_num> <device address> <profile script>\n", argv[0]);
+		printf("sample manifest:\n  0 0x3b cam0.txt\n  1 0x3b cam1.txt\n");
+		return -1;
+	}
+
+	num_cams = multicfg_load(argv[1]);
+	if (num_cams < 0)
+		return -1;
+
+	for (i = 0; i < num_cams; i++)
+	{
+		for (j = 0; j < num_buses && buses[j].bus != cams[i].bus; j++)
+			;
+		if (j == num_buses)
+			buses[num_buses++].bus = cams[i].bus;
+		buses[j].cams[buses[j].num_cams++] = &cams[i];
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < num_buses; i++)
+	{
+		if (pthread_create(&buses[i].thread, NULL, multicfg_worker, &buses[i]) != 0)
+		{
+			printf("Couldn't start worker for bus %d\n", buses[i].bus);
+			num_buses = i;
+			failed = 1;
+			break;
+		}
+	}
+	for (i = 0; i < num_buses; i++)
+		pthread_join(buses[i].thread, NULL);
+	total = multicfg_usecs(&start);
+
+	for (i = 0; i < num_cams; i++)
+	{
+		if (cams[i].ret < 0)
+		{
+			printf("bus %d addr %#x %s: FAILED after %ld us\n", cams[i].bus, cams[i].dev_addr,
+			       cams[i].profile, cams[i].usecs);
+			failed = 1;
+			continue;
+		}
+		printf("bus %d addr %#x %s: %d regs in %d transfers, %ld us\n", cams[i].bus,
+		       cams[i].dev_addr, cams[i].profile, cams[i].num_regs, cams[i].xfers, cams[i].usecs);
+	}
+	printf("====I2C multicfg: %d cameras on %d buses in %ld us====\n", num_cams, num_buses, total);
+
+	return failed ? -1 : 0;
+}
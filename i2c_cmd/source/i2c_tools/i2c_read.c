@@ -14,58 +14,80 @@
 
 #include "i2c_comm.h"
 
-#define I2C_DEVICE_NAME_LEN 13	// "/dev/i2c-XXX"+NULL
 static char i2c_device_name[I2C_DEVICE_NAME_LEN];
 
-static int i2c_rd(int fd, uint8_t i2c_addr, uint16_t reg, uint8_t *values, uint32_t n)
+/* default burst chunk, well below the 8192 byte i2c-dev message limit */
+#define I2C_READ_CHUNK	256
+#define I2C_READ_CHUNK_MAX	8192
+
+enum read_format {
+	FMT_TEXT = 0,	/* legacy listing, first byte as exit status */
+	FMT_HEX,
+	FMT_BIN,
+	FMT_JSON,
+};
+
+static void print_values(int fmt, U32 bus, U32 i2c_addr, U32 reg, const U8 *values, U32 n)
 {
-	int err;
-	int i = 0;
-	uint8_t buf[2] = { reg >> 8, reg & 0xff };
-	struct i2c_rdwr_ioctl_data msgset;
-	struct i2c_msg msgs[2] = {
-		{
-			 .addr = i2c_addr,
-			 .flags = 0,
-			 .len = 2,
-			 .buf = buf,
-		},
-		{
-			.addr = i2c_addr,
-			.flags = I2C_M_RD,
-			.len = n,
-			.buf = values,
-		},
-	};
-
-	msgset.msgs = msgs;
-	msgset.nmsgs = 2;
-
-	err = ioctl(fd, I2C_RDWR, &msgset);
-	printf("Read i2c addr %02X\n", i2c_addr);
-	if (err != msgset.nmsgs)
-		return -1;
-	for(i = 0; i < n;++i)
+	U32 i;
+
+	switch (fmt)
 	{
-		printf("addr %04x : value %02x \n",reg+i,values[i]);
+	case FMT_HEX:
+		for (i = 0; i < n; ++i)
+			printf("%02x%c", values[i], (i == n - 1) ? '\n' : ' ');
+		break;
+	case FMT_BIN:
+		fwrite(values, 1, n, stdout);
+		break;
+	case FMT_JSON:
+		printf("{\"bus\":%u,\"addr\":%u,\"reg\":%u,\"len\":%u,\"data\":[", bus, i2c_addr, reg, n);
+		for (i = 0; i < n; ++i)
+			printf("%s%u", i ? "," : "", values[i]);
+		printf("]}\n");
+		break;
+	default:
+		printf("Read i2c addr %02X\n", i2c_addr);
+		for (i = 0; i < n; ++i)
+		{
+			printf("addr %04x : value %02x \n", reg + i, values[i]);
+		}
+		break;
 	}
-	
-	return 0;
 }
 
+static int parse_format(const CHAR *str)
+{
+	if (strcmp(str, "hex") == 0)
+		return FMT_HEX;
+	if (strcmp(str, "bin") == 0)
+		return FMT_BIN;
+	if (strcmp(str, "json") == 0)
+		return FMT_JSON;
+	if (strcmp(str, "text") == 0)
+		return FMT_TEXT;
+	return -1;
+}
 
 int main(int argc, char *argv[])
 {
 	U32 I2C_port;
 	U32 device_addr;
 	U32 reg_addr;
-	U32 new_data;
-	U8 value[512];
+	U8 *value;
 	U32 num = 1;
+	U32 chunk = I2C_READ_CHUNK;
+	int fmt = FMT_TEXT;
+	const struct reg_desc *desc;
 	int result;
+	int fd;
+	int arg = 4;
+
 	if (argc < 4)
 	{
-		printf("usage: %s <bus_num> <device address(8bit)> <register address(16bits)> <len default:1 max100>. sample: %s 0x0 0xA0 0x1000 0x2\n", argv[0], argv[0]);
+		printf("usage: %s <bus_num> <device address(8bit)> <register address(16bits)|name> <len default:1> <format text/hex/bin/json> <chunk default:%d>. sample: %s 0x0 0xA0 0x1000 0x2\n", argv[0], I2C_READ_CHUNK, argv[0]);
+		printf("       burst sample: %s 0x0 0x3b 0x0211 8 json\n", argv[0]);
+		printf("       a register name may skip the len: %s 0x0 0x3b PRODUCTID hex\n", argv[0]);
 		return -1;
 	}
 
@@ -80,41 +102,92 @@ int main(int argc, char *argv[])
 	}
 
 	if(StrToNumber(argv[3], &reg_addr) != HI_SUCCESS ) {
-		printf("Please input reg addr like 0x100 0r 256.\r\n");
-		return -1;
+		/* a register name from the map reads the whole group */
+		desc = cs_reg_find(argv[3]);
+		if (desc == NULL) {
+			printf("Please input reg addr like 0x100 0r 256.\r\n");
+			return -1;
+		}
+		reg_addr = desc->addr;
+		num = desc->width;
 	}
-	if(argc >=5)
+	/* the len is optional when a format keyword follows the register */
+	if(argc > arg && parse_format(argv[arg]) < 0)
 	{
-		if(StrToNumber(argv[4], &num) != HI_SUCCESS ) {
-			printf("Please input reg addr like 0x100 0r 256.\r\n");
+		if(StrToNumber(argv[arg], &num) != HI_SUCCESS ) {
+			printf("Please input len like 0x100 0r 256.\r\n");
+			return -1;
+		}
+		arg++;
+	}
+	if(argc > arg)
+	{
+		fmt = parse_format(argv[arg]);
+		if (fmt < 0) {
+			printf("Please input format text, hex, bin or json.\r\n");
+			return -1;
+		}
+		arg++;
+	}
+	if(argc > arg)
+	{
+		if(StrToNumber(argv[arg], &chunk) != HI_SUCCESS || chunk == 0) {
+			printf("Please input chunk like 32 or 0x20.\r\n");
 			return -1;
 		}
+		if (chunk > I2C_READ_CHUNK_MAX)
+			chunk = I2C_READ_CHUNK_MAX;
+	}
+	if (reg_addr > 0xFFFF || num == 0 || num > 0x10000 - reg_addr)
+	{
+		printf("register range %#x + %#x is out of the 16bit address space\n", reg_addr, num);
+		return -1;
 	}
+
 	snprintf(i2c_device_name, sizeof(i2c_device_name), "/dev/i2c-%d", I2C_port);
-	printf("Using i2C device %s\n", i2c_device_name);
-	
-	printf("====I2C read:<%#x> <%#x> <%#x>====\n", device_addr, reg_addr, num);
-	
-	int fd;
-	fd = open(i2c_device_name, O_RDWR);
-	if (!fd)
+	if (fmt == FMT_TEXT)
+	{
+		printf("Using i2C device %s\n", i2c_device_name);
+		printf("====I2C read:<%#x> <%#x> <%#x>====\n", device_addr, reg_addr, num);
+	}
+
+	value = calloc(num, 1);
+	if (value == NULL)
 	{
-		printf("Couldn't open I2C device\n");
+		printf("Out of memory\n");
+		return -1;
+	}
+
+	/* attaches the register cache of this bus, not of bus 0 */
+	fd = i2c_open_bus(I2C_port);
+	if (fd < 0)
+	{
+		free(value);
 		return -1;
 	}
 	if (ioctl(fd, I2C_SLAVE_FORCE, device_addr) < 0)
 	{
 		printf("Failed to set I2C address\n");
+		close(fd);
+		free(value);
 		return -1;
 	}
 
-	
-	i2c_rd(fd, device_addr,reg_addr, &value, num);
-	
+	if (i2c_read_burst(fd, device_addr, reg_addr, value, num, chunk) < 0)
+	{
+		if (fmt == FMT_TEXT)
+			printf("Read i2c addr %02X failed\n", device_addr);
+		close(fd);
+		free(value);
+		return -1;
+	}
+	print_values(fmt, I2C_port, device_addr, reg_addr, value, num);
+
 	close(fd);
-	
-	
-	return value[0];
-	
-}
 
+	/* scripts take the first byte from the exit status in text mode */
+	result = (fmt == FMT_TEXT) ? value[0] : 0;
+	free(value);
+	return result;
+
+}
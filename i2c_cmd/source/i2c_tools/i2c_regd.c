@@ -0,0 +1,417 @@
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "i2c_comm.h"
+
+/*
+ * i2c_regd - register access service for CS/VEYE cameras.
+ *
+ * Keeps /dev/i2c-N open and serves line based requests on a unix socket,
+ * so a multi byte register costs one ioctl instead of one process per byte.
+ *
+ *   r <name|addr> [len]        -> ok <value> <hex bytes...>
+ *   w <name> <value>           -> ok      (value split little endian)
+ *   w <addr> <byte> [byte...]  -> ok
+ *   d <device addr>            -> ok      (per connection, default from argv)
+ *   q                          -> closes the connection
+ *
+ * Errors are answered with "err <reason>". Client sockets are non blocking,
+ * a client that does not read its replies is dropped rather than stalling
+ * the others.
+ */
+
+#define REGD_DEFAULT_SOCK	"/var/run/i2c_regd.sock"
+#define REGD_MAX_CLIENTS	16
+#define REGD_LINE_LEN		256
+#define REGD_MAX_READ		64
+
+struct regd_client {
+	int fd;
+	U8 dev_addr;
+	U32 len;
+	CHAR line[REGD_LINE_LEN];
+};
+
+static int bus_fd = -1;
+static U8 default_addr = 0x3b;
+static struct regd_client clients[REGD_MAX_CLIENTS];
+
+/* resolve a register token, either a map name or a plain address */
+static int regd_parse_reg(CHAR *tok, U32 *addr, U32 *width, const struct reg_desc **desc)
+{
+	*desc = NULL;
+	if (StrToNumber(tok, addr) == HI_SUCCESS)
+	{
+		if (*addr > 0xFFFF)
+			return HI_FAILURE;
+		*width = 1;
+		return HI_SUCCESS;
+	}
+	*desc = cs_reg_find(tok);
+	if (*desc == NULL)
+		return HI_FAILURE;
+	*addr = (*desc)->addr;
+	*width = (*desc)->width;
+	return HI_SUCCESS;
+}
+
+static void regd_exec(struct regd_client *cl, CHAR *cmd, CHAR *reply, size_t size)
+{
+	CHAR *argv[REGD_MAX_READ + 3];
+	int argc = 0;
+	CHAR *tok, *save = NULL;
+	const struct reg_desc *desc;
+	U32 addr, width, value, i;
+	U8 buf[REGD_MAX_READ];
+	int off;
+
+	for (tok = strtok_r(cmd, " \t\r", &save); tok && argc < (int)(sizeof(argv) / sizeof(argv[0]));
+	     tok = strtok_r(NULL, " \t\r", &save))
+		argv[argc++] = tok;
+
+	if (argc == 0)
+	{
+		snprintf(reply, size, "err empty\n");
+		return;
+	}
+
+	switch (argv[0][0])
+	{
+	case 'r':
+		if (argc < 2 || regd_parse_reg(argv[1], &addr, &width, &desc) != HI_SUCCESS)
+		{
+			snprintf(reply, size, "err bad register\n");
+			return;
+		}
+		if (argc >= 3 && (StrToNumber(argv[2], &width) != HI_SUCCESS ||
+				  width == 0 || width > REGD_MAX_READ))
+		{
+			snprintf(reply, size, "err bad len\n");
+			return;
+		}
+		if (i2c_read_regs(bus_fd, cl->dev_addr, addr, buf, width) < 0)
+		{
+			snprintf(reply, size, "err i2c read %#x\n", addr);
+			return;
+		}
+		value = 0;
+		for (i = 0; i < width && i < 4; i++)
+			value |= (U32)buf[i] << (8 * i);
+		off = snprintf(reply, size, "ok %u", value);
+		for (i = 0; i < width && off < (int)size - 4; i++)
+			off += snprintf(reply + off, size - off, " %02x", buf[i]);
+		snprintf(reply + off, size - off, "\n");
+		return;
+
+	case 'w':
+		if (argc < 3 || regd_parse_reg(argv[1], &addr, &width, &desc) != HI_SUCCESS)
+		{
+			snprintf(reply, size, "err bad register\n");
+			return;
+		}
+		if (desc != NULL)
+		{
+			if (desc->access == REG_ACC_CONST || desc->access == REG_ACC_RO)
+			{
+				snprintf(reply, size, "err %s is read only\n", desc->name);
+				return;
+			}
+			if (StrToNumber(argv[2], &value) != HI_SUCCESS)
+			{
+				snprintf(reply, size, "err bad value\n");
+				return;
+			}
+			if (width < 4 && (value >> (8 * width)) != 0)
+			{
+				snprintf(reply, size, "err %#x does not fit %s\n", value, desc->name);
+				return;
+			}
+			for (i = 0; i < width; i++)
+				buf[i] = (value >> (8 * i)) & 0xFF;
+		}
+		else
+		{
+			width = argc - 2;
+			if (width > REGD_MAX_READ)
+			{
+				snprintf(reply, size, "err too many bytes\n");
+				return;
+			}
+			for (i = 0; i < width; i++)
+			{
+				if (StrToNumber(argv[2 + i], &value) != HI_SUCCESS || value > 0xFF)
+				{
+					snprintf(reply, size, "err bad value\n");
+					return;
+				}
+				buf[i] = value;
+			}
+		}
+		if (i2c_write_regs(bus_fd, cl->dev_addr, addr, buf, width) < 0)
+		{
+			snprintf(reply, size, "err i2c write %#x\n", addr);
+			return;
+		}
+		snprintf(reply, size, "ok\n");
+		return;
+
+	case 'd':
+		if (argc < 2 || StrToNumber(argv[1], &value) != HI_SUCCESS || value > 0x7F)
+		{
+			snprintf(reply, size, "err bad device address\n");
+			return;
+		}
+		cl->dev_addr = value;
+		snprintf(reply, size, "ok\n");
+		return;
+
+	default:
+		snprintf(reply, size, "err unknown command %s\n", argv[0]);
+		return;
+	}
+}
+
+static void regd_close(struct regd_client *cl)
+{
+	close(cl->fd);
+	cl->fd = -1;
+}
+
+/* a reply that does not fit the socket buffer right away drops the client */
+static int regd_reply(struct regd_client *cl, const CHAR *reply)
+{
+	ssize_t len = strlen(reply);
+
+	if (write(cl->fd, reply, len) != len)
+	{
+		regd_close(cl);
+		return -1;
+	}
+	return 0;
+}
+
+/* consume whatever the client sent, answer every complete line */
+static void regd_service(struct regd_client *cl)
+{
+	CHAR reply[REGD_LINE_LEN * 2];
+	CHAR *nl;
+	ssize_t n;
+
+	n = read(cl->fd, cl->line + cl->len, sizeof(cl->line) - 1 - cl->len);
+	if (n < 0 && (errno == EAGAIN || errno == EINTR))
+		return;
+	if (n <= 0)
+	{
+		regd_close(cl);
+		return;
+	}
+	cl->len += n;
+	cl->line[cl->len] = '\0';
+
+	while ((nl = strchr(cl->line, '\n')) != NULL)
+	{
+		*nl = '\0';
+		if (cl->line[0] == 'q')
+		{
+			regd_close(cl);
+			return;
+		}
+		regd_exec(cl, cl->line, reply, sizeof(reply));
+		if (regd_reply(cl, reply) < 0)
+			return;
+		cl->len -= nl + 1 - cl->line;
+		memmove(cl->line, nl + 1, cl->len + 1);
+	}
+
+	if (cl->len == sizeof(cl->line) - 1)
+	{
+		snprintf(reply, sizeof(reply), "err line too long\n");
+		regd_reply(cl, reply);
+		cl->len = 0;
+	}
+}
+
+static int regd_listen(const CHAR *path)
+{
+	struct sockaddr_un sa;
+	int fd;
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		printf("Couldn't create socket\n");
+		return -1;
+	}
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	strncpy(sa.sun_path, path, sizeof(sa.sun_path) - 1);
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 || listen(fd, REGD_MAX_CLIENTS) < 0)
+	{
+		printf("Couldn't listen on %s: %s\n", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int regd_serve(int listen_fd)
+{
+	struct pollfd pfd[REGD_MAX_CLIENTS + 1];
+	int i, n, fd;
+
+	for (i = 0; i < REGD_MAX_CLIENTS; i++)
+		clients[i].fd = -1;
+
+	for (;;)
+	{
+		pfd[0].fd = listen_fd;
+		pfd[0].events = POLLIN;
+		for (i = 0; i < REGD_MAX_CLIENTS; i++)
+		{
+			pfd[i + 1].fd = clients[i].fd;
+			pfd[i + 1].events = POLLIN;
+		}
+
+		n = poll(pfd, REGD_MAX_CLIENTS + 1, -1);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		if (pfd[0].revents & POLLIN)
+		{
+			fd = accept(listen_fd, NULL, NULL);
+			if (fd >= 0 && fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0)
+			{
+				close(fd);
+				fd = -1;
+			}
+			for (i = 0; fd >= 0 && i < REGD_MAX_CLIENTS; i++)
+			{
+				if (clients[i].fd < 0)
+				{
+					clients[i].fd = fd;
+					clients[i].dev_addr = default_addr;
+					clients[i].len = 0;
+					break;
+				}
+			}
+			if (fd >= 0 && i == REGD_MAX_CLIENTS)
+				close(fd);
+		}
+
+		for (i = 0; i < REGD_MAX_CLIENTS; i++)
+		{
+			if (clients[i].fd >= 0 && (pfd[i + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+				regd_service(&clients[i]);
+		}
+	}
+}
+
+/* one shot client, for scripts: i2c_regd -c <socket> r EXP_TIME */
+static int regd_client_cmd(const CHAR *path, int argc, CHAR *argv[])
+{
+	struct sockaddr_un sa;
+	CHAR line[REGD_LINE_LEN * 2];
+	int fd, i, off = 0;
+	ssize_t n;
+
+	for (i = 0; i < argc && off < (int)sizeof(line) - 2; i++)
+		off += snprintf(line + off, sizeof(line) - off, "%s%s", i ? " " : "", argv[i]);
+	line[off++] = '\n';
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	strncpy(sa.sun_path, path, sizeof(sa.sun_path) - 1);
+	if (fd < 0 || connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+	{
+		printf("Couldn't connect to %s\n", path);
+		return -1;
+	}
+	if (write(fd, line, off) != off)
+	{
+		close(fd);
+		return -1;
+	}
+	off = 0;
+	while (off < (int)sizeof(line) - 1 && (n = read(fd, line + off, sizeof(line) - 1 - off)) > 0)
+	{
+		off += n;
+		if (line[off - 1] == '\n')
+			break;
+	}
+	close(fd);
+	line[off] = '\0';
+	printf("%s", line);
+	return strncmp(line, "ok", 2) == 0 ? 0 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+	U32 I2C_port;
+	U32 device_addr = 0x3b;
+	const CHAR *sock_path = REGD_DEFAULT_SOCK;
+	int listen_fd;
+
+	if (argc >= 4 && strcmp(argv[1], "-c") == 0)
+		return regd_client_cmd(argv[2], argc - 3, argv + 3);
+
+	if (argc < 2)
+	{
+		printf("usage: %s <bus_num> [device address default:0x3b] [socket default:%s]\n", argv[0], REGD_DEFAULT_SOCK);
+		printf("       %s -c <socket> <r|w|d> <register name|address> [len|value...]\n", argv[0]);
+		printf("sample: %s 0x0 0x3b; %s -c %s r EXP_TIME\n", argv[0], argv[0], REGD_DEFAULT_SOCK);
+		return -1;
+	}
+
+	if (StrToNumber(argv[1], &I2C_port) != HI_SUCCESS) {
+		printf("Please input i2c port like 0x100 or 256.\r\n");
+		return -1;
+	}
+
+	if (argc >= 3 && (StrToNumber(argv[2], &device_addr) != HI_SUCCESS || device_addr > 0x7F)) {
+		printf("Please input dev addr like 0x3b.\r\n");
+		return -1;
+	}
+	default_addr = device_addr;
+
+	if (argc >= 4)
+		sock_path = argv[3];
+
+	bus_fd = i2c_open_bus(I2C_port);
+	if (bus_fd < 0)
+		return -1;
+
+	listen_fd = regd_listen(sock_path);
+	if (listen_fd < 0)
+	{
+		close(bus_fd);
+		return -1;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	printf("====I2C regd: bus %d addr %#x socket %s====\n", I2C_port, device_addr, sock_path);
+	regd_serve(listen_fd);
+
+	close(listen_fd);
+	close(bus_fd);
+	return 0;
+}
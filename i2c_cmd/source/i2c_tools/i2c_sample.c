@@ -0,0 +1,446 @@
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "i2c_comm.h"
+
+/*
+ * i2c_sample - periodic register telemetry for CS cameras.
+ *
+ * A sampler thread reads the selected register groups at a fixed rate with
+ * one I2C_RDWR per sample (neighbouring groups are merged into one read) and
+ * pushes timestamped samples into a single producer / single consumer ring.
+ * The main thread drains the ring to CSV or binary, so file I/O never
+ * delays a sample. Timing statistics go to stderr at the end.
+ *
+ * Binary output: "CSMP" version(1) ngroups(1) nbytes(2, le), then per group
+ * its name NUL terminated and width(1), then per sample
+ * ts_ns(8) seq(4) data[nbytes], all little endian host order.
+ *
+ * seq is the slot number on the sampling grid, so failed reads and slots
+ * missed because the sampler fell behind both show up as gaps in seq, and
+ * both count towards the requested number of samples.
+ */
+
+#define SAMPLE_RING_SIZE	4096	/* power of two */
+#define SAMPLE_MAX_GROUPS	16
+#define SAMPLE_MAX_BYTES	64
+#define SAMPLE_MAX_SPANS	(I2C_RDWR_IOCTL_MAX_MSGS / 2)
+#define SAMPLE_SPAN_GAP		4	/* merge groups at most this many bytes apart */
+
+struct sample {
+	uint64_t ts_ns;
+	uint32_t seq;
+	uint8_t data[SAMPLE_MAX_BYTES];
+};
+
+struct sample_span {
+	uint16_t reg;
+	uint16_t len;
+	uint16_t off;	/* where the span lands in the raw read buffer */
+};
+
+static const char *default_groups[] = {
+	"MIPI_COUNT", "MIPI_STAT", "EXP_TIME", "AGAIN_NOW", "DGAIN_NOW",
+	"WB_RGAIN", "WB_GGAIN", "WB_BGAIN", "WB_COLORTEMP",
+};
+
+static const struct reg_desc *groups[SAMPLE_MAX_GROUPS];
+static uint16_t group_off[SAMPLE_MAX_GROUPS];	/* offset in sample.data */
+static int num_groups;
+static uint32_t sample_bytes;
+
+static struct sample_span spans[SAMPLE_MAX_SPANS];
+static int num_spans;
+static uint16_t raw_group_off[SAMPLE_MAX_GROUPS];	/* offset in the raw read buffer */
+static uint32_t raw_bytes;
+
+static struct sample ring[SAMPLE_RING_SIZE];
+static atomic_uint ring_head;	/* written by the sampler only */
+static atomic_uint ring_tail;	/* written by the writer only */
+static atomic_int sampler_done;
+static volatile sig_atomic_t stop;
+
+/* statistics, owned by the sampler thread until it is joined */
+static uint64_t stat_samples, stat_errors, stat_overruns, stat_missed;
+static uint64_t stat_io_min = ~0ULL, stat_io_max, stat_io_sum;
+static uint64_t stat_late_max, stat_late_sum;
+
+struct sampler_args {
+	int fd;
+	U8 dev_addr;
+	uint64_t period_ns;
+	uint64_t count;
+};
+
+static uint64_t ts_ns(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts_ns(&ts);
+}
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	stop = 1;
+}
+
+/* sort the groups by address and cover them with as few reads as possible */
+static int plan_spans(void)
+{
+	const struct reg_desc *tmp;
+	uint16_t end;
+	int i, j;
+
+	for (i = 0; i < num_groups; i++)
+	{
+		for (j = i + 1; j < num_groups; j++)
+		{
+			if (groups[j]->addr < groups[i]->addr)
+			{
+				tmp = groups[i];
+				groups[i] = groups[j];
+				groups[j] = tmp;
+			}
+		}
+	}
+
+	num_spans = 0;
+	raw_bytes = 0;
+	sample_bytes = 0;
+	for (i = 0; i < num_groups; i++)
+	{
+		end = num_spans ? spans[num_spans - 1].reg + spans[num_spans - 1].len : 0;
+		if (num_spans && groups[i]->addr < end + SAMPLE_SPAN_GAP)
+		{
+			if (groups[i]->addr + groups[i]->width > end)
+			{
+				raw_bytes += groups[i]->addr + groups[i]->width - end;
+				spans[num_spans - 1].len = groups[i]->addr + groups[i]->width - spans[num_spans - 1].reg;
+			}
+		}
+		else
+		{
+			if (num_spans == SAMPLE_MAX_SPANS)
+				return -1;
+			spans[num_spans].reg = groups[i]->addr;
+			spans[num_spans].len = groups[i]->width;
+			spans[num_spans].off = raw_bytes;
+			raw_bytes += groups[i]->width;
+			num_spans++;
+		}
+		raw_group_off[i] = spans[num_spans - 1].off + groups[i]->addr - spans[num_spans - 1].reg;
+		group_off[i] = sample_bytes;
+		sample_bytes += groups[i]->width;
+	}
+	return raw_bytes > SAMPLE_MAX_BYTES * 2 || sample_bytes > SAMPLE_MAX_BYTES ? -1 : 0;
+}
+
+static void *sampler(void *arg)
+{
+	struct sampler_args *a = arg;
+	struct i2c_rdwr_ioctl_data msgset;
+	struct i2c_msg msgs[SAMPLE_MAX_SPANS * 2];
+	uint8_t addr_bufs[SAMPLE_MAX_SPANS][2];
+	uint8_t raw[SAMPLE_MAX_BYTES * 2];
+	struct timespec next;
+	struct sample *s;
+	uint64_t t0, t1, due, seq, skip;
+	unsigned int head;
+	int i, ok;
+
+	/* the transaction never changes, build it once */
+	for (i = 0; i < num_spans; i++)
+	{
+		addr_bufs[i][0] = spans[i].reg >> 8;
+		addr_bufs[i][1] = spans[i].reg & 0xff;
+		msgs[2 * i].addr = a->dev_addr;
+		msgs[2 * i].flags = 0;
+		msgs[2 * i].len = 2;
+		msgs[2 * i].buf = addr_bufs[i];
+		msgs[2 * i + 1].addr = a->dev_addr;
+		msgs[2 * i + 1].flags = I2C_M_RD;
+		msgs[2 * i + 1].len = spans[i].len;
+		msgs[2 * i + 1].buf = raw + spans[i].off;
+	}
+	msgset.msgs = msgs;
+	msgset.nmsgs = num_spans * 2;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	due = ts_ns(&next);
+	for (seq = 0; !stop && (a->count == 0 || seq < a->count); seq++)
+	{
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR && !stop)
+			;
+		t0 = now_ns();
+		ok = ioctl(a->fd, I2C_RDWR, &msgset) == (int)msgset.nmsgs;
+		t1 = now_ns();
+		if (!ok)
+			stat_errors++;
+
+		stat_io_sum += t1 - t0;
+		if (t1 - t0 < stat_io_min)
+			stat_io_min = t1 - t0;
+		if (t1 - t0 > stat_io_max)
+			stat_io_max = t1 - t0;
+		if (t0 > due)
+		{
+			stat_late_sum += t0 - due;
+			if (t0 - due > stat_late_max)
+				stat_late_max = t0 - due;
+		}
+
+		/* a failed read leaves a gap in seq rather than a bogus sample */
+		head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+		if (ok && head - atomic_load_explicit(&ring_tail, memory_order_acquire) == SAMPLE_RING_SIZE)
+		{
+			stat_overruns++;
+		}
+		else if (ok)
+		{
+			s = &ring[head & (SAMPLE_RING_SIZE - 1)];
+			s->ts_ns = t0;
+			s->seq = seq;
+			for (i = 0; i < num_groups; i++)
+				memcpy(s->data + group_off[i], raw + raw_group_off[i], groups[i]->width);
+			atomic_store_explicit(&ring_head, head + 1, memory_order_release);
+		}
+		stat_samples++;
+
+		/* keep the grid, skip the slots we are already past */
+		due += a->period_ns;
+		if (t1 > due)
+		{
+			skip = (t1 - due) / a->period_ns + 1;
+			stat_missed += skip;
+			seq += skip;
+			due += skip * a->period_ns;
+		}
+		next.tv_sec = due / 1000000000ULL;
+		next.tv_nsec = due % 1000000000ULL;
+	}
+	atomic_store_explicit(&sampler_done, 1, memory_order_release);
+	return NULL;
+}
+
+static void write_header(FILE *out, int binary)
+{
+	uint8_t hdr[8] = { 'C', 'S', 'M', 'P', 1, num_groups, sample_bytes & 0xff, sample_bytes >> 8 };
+	int i;
+
+	if (!binary)
+	{
+		fprintf(out, "ts_ns,seq");
+		for (i = 0; i < num_groups; i++)
+			fprintf(out, ",%s", groups[i]->name);
+		fprintf(out, "\n");
+		return;
+	}
+	fwrite(hdr, 1, sizeof(hdr), out);
+	for (i = 0; i < num_groups; i++)
+	{
+		fwrite(groups[i]->name, 1, strlen(groups[i]->name) + 1, out);
+		fputc(groups[i]->width, out);
+	}
+}
+
+static void write_sample(FILE *out, int binary, const struct sample *s)
+{
+	uint32_t value;
+	int i, j;
+
+	if (binary)
+	{
+		fwrite(&s->ts_ns, sizeof(s->ts_ns), 1, out);
+		fwrite(&s->seq, sizeof(s->seq), 1, out);
+		fwrite(s->data, 1, sample_bytes, out);
+		return;
+	}
+	fprintf(out, "%llu,%u", (unsigned long long)s->ts_ns, s->seq);
+	for (i = 0; i < num_groups; i++)
+	{
+		value = 0;
+		for (j = 0; j < groups[i]->width; j++)
+			value |= (uint32_t)s->data[group_off[i] + j] << (8 * j);
+		fprintf(out, ",%u", value);
+	}
+	fprintf(out, "\n");
+}
+
+/* writer side of the ring, runs until the sampler is done and the ring is empty */
+static void drain(FILE *out, int binary)
+{
+	struct timespec idle = { 0, 2000000 };
+	unsigned int head, tail;
+	int done;
+
+	for (;;)
+	{
+		done = atomic_load_explicit(&sampler_done, memory_order_acquire);
+		head = atomic_load_explicit(&ring_head, memory_order_acquire);
+		tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+		while (tail != head)
+		{
+			write_sample(out, binary, &ring[tail & (SAMPLE_RING_SIZE - 1)]);
+			tail++;
+			atomic_store_explicit(&ring_tail, tail, memory_order_release);
+		}
+		if (done)
+			break;
+		fflush(out);
+		nanosleep(&idle, NULL);
+	}
+	fflush(out);
+}
+
+int main(int argc, char *argv[])
+{
+	U32 I2C_port;
+	U32 device_addr;
+	U32 rate, count;
+	struct sampler_args args;
+	pthread_t thread;
+	uint64_t start, elapsed;
+	FILE *out = stdout;
+	int binary = 0, fd, i;
+
+	if (argc < 5)
+	{
+		printf("usage: %s <bus_num> <device address> <rate hz> <samples, 0 until ctrl-c> [csv|bin] [outfile|-] [register name...]\n", argv[0]);
+		printf("sample: %s 0x0 0x3b 200 1000 csv exp.csv EXP_TIME AGAIN_NOW DGAIN_NOW MIPI_COUNT\n", argv[0]);
+		return -1;
+	}
+
+	if(StrToNumber(argv[1], &I2C_port) != HI_SUCCESS ) {
+		printf("Please input i2c port like 0x100 or 256.\r\n");
+		return -1;
+	}
+
+	if(StrToNumber(argv[2], &device_addr) != HI_SUCCESS || device_addr > 0x7F) {
+		printf("Please input dev addr like 0x3b.\r\n");
+		return -1;
+	}
+
+	if (StrToNumber(argv[3], &rate) != HI_SUCCESS || rate == 0 || rate > 100000 ||
+	    StrToNumber(argv[4], &count) != HI_SUCCESS)
+	{
+		printf("Please input rate and sample count like 200 1000.\r\n");
+		return -1;
+	}
+
+	if (argc >= 6)
+	{
+		if (strcmp(argv[5], "bin") == 0)
+			binary = 1;
+		else if (strcmp(argv[5], "csv") != 0)
+		{
+			printf("Unknown format %s, use csv or bin\n", argv[5]);
+			return -1;
+		}
+	}
+
+	if (argc >= 8)
+	{
+		if (argc - 7 > SAMPLE_MAX_GROUPS)
+		{
+			printf("At most %d registers per sample\n", SAMPLE_MAX_GROUPS);
+			return -1;
+		}
+		for (i = 7; i < argc; i++)
+		{
+			groups[num_groups] = cs_reg_find(argv[i]);
+			if (groups[num_groups] == NULL)
+			{
+				printf("Unknown register %s\n", argv[i]);
+				return -1;
+			}
+			num_groups++;
+		}
+	}
+	else
+	{
+		for (i = 0; i < (int)(sizeof(default_groups) / sizeof(default_groups[0])); i++)
+			groups[num_groups++] = cs_reg_find(default_groups[i]);
+	}
+	if (plan_spans() < 0)
+	{
+		printf("Too many registers for one sample\n");
+		return -1;
+	}
+
+	fd = i2c_open_bus(I2C_port);
+	if (fd < 0)
+		return -1;
+
+	if (argc >= 7 && strcmp(argv[6], "-") != 0)
+	{
+		out = fopen(argv[6], binary ? "wb" : "w");
+		if (out == NULL)
+		{
+			printf("Couldn't create %s\n", argv[6]);
+			close(fd);
+			return -1;
+		}
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	write_header(out, binary);
+	args.fd = fd;
+	args.dev_addr = device_addr;
+	args.period_ns = 1000000000ULL / rate;
+	args.count = count;
+	start = now_ns();
+	if (pthread_create(&thread, NULL, sampler, &args) != 0)
+	{
+		printf("Couldn't start sampler\n");
+		close(fd);
+		return -1;
+	}
+	drain(out, binary);
+	pthread_join(thread, NULL);
+	elapsed = now_ns() - start;
+
+	if (out != stdout)
+		fclose(out);
+	close(fd);
+
+	fprintf(stderr, "====I2C sample: %llu samples in %llu ms, %d groups %u bytes in %d reads per sample====\n",
+		(unsigned long long)stat_samples, (unsigned long long)(elapsed / 1000000),
+		num_groups, raw_bytes, num_spans);
+	if (stat_samples)
+		fprintf(stderr, "i2c time us min %llu avg %llu max %llu, wakeup late us avg %llu max %llu, bus busy %llu%%\n",
+			(unsigned long long)(stat_io_min / 1000),
+			(unsigned long long)(stat_io_sum / stat_samples / 1000),
+			(unsigned long long)(stat_io_max / 1000),
+			(unsigned long long)(stat_late_sum / stat_samples / 1000),
+			(unsigned long long)(stat_late_max / 1000),
+			(unsigned long long)(elapsed ? stat_io_sum * 100 / elapsed : 0));
+	fprintf(stderr, "errors %llu, missed slots %llu, ring overruns %llu\n",
+		(unsigned long long)stat_errors, (unsigned long long)stat_missed,
+		(unsigned long long)stat_overruns);
+
+	return stat_errors ? -1 : 0;
+}
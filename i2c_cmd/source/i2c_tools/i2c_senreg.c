@@ -0,0 +1,205 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "i2c_comm.h"
+
+/*
+ * i2c_senreg - raw sensor register access through the CS camera firmware.
+ *
+ *   i2c_senreg <bus> <addr> r <sensor reg> [count]     read count registers
+ *   i2c_senreg <bus> <addr> w <sensor reg> <value> ... write register pairs
+ *   i2c_senreg <bus> <addr> -f <script|->              run a script
+ *
+ * A script line holds "<sensor reg>" to read it or "<sensor reg> <value>"
+ * to write it, '#' starts a comment. All accesses of one invocation run
+ * back to back through senreg_xfer in one process, which saves the start
+ * up and script overhead of one i2c_write/i2c_read call per step, but not
+ * the firmware's time: the window has no completion flag to poll, so
+ * every access waits the fixed 10 ms of cs_mipi_i2c.sh. 300 registers
+ * take over 3 s, this is not a fast bulk path.
+ *
+ * Writes need the firmware's write request code in I2C_SENREG_WRITE, they
+ * fail without it.
+ */
+
+static long senreg_tool_usecs(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000000L + (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+static int senreg_add(struct senreg_op **ops, int *num, int *size, U32 reg, int write, U32 value)
+{
+	struct senreg_op *tmp;
+
+	if (reg > 0xFFFF || value > 0xFF)
+		return -1;
+	if (*num == *size)
+	{
+		*size = *size ? *size * 2 : 64;
+		tmp = realloc(*ops, *size * sizeof(**ops));
+		if (tmp == NULL)
+			return -1;
+		*ops = tmp;
+	}
+	(*ops)[*num].addr = reg;
+	(*ops)[*num].value = value;
+	(*ops)[*num].write = write;
+	(*ops)[*num].ret = -1;
+	(*num)++;
+	return 0;
+}
+
+static int senreg_load(const CHAR *path, struct senreg_op **ops, int *num, int *size)
+{
+	CHAR line[128];
+	CHAR *tok[2], *p, *save;
+	U32 reg, value;
+	int lineno = 0;
+	FILE *fp;
+
+	fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+	if (fp == NULL)
+	{
+		printf("Couldn't open script %s\n", path);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		lineno++;
+		if ((p = strchr(line, '#')) != NULL)
+			*p = '\0';
+		tok[0] = strtok_r(line, " \t\r\n,", &save);
+		if (tok[0] == NULL)
+			continue;
+		tok[1] = strtok_r(NULL, " \t\r\n,", &save);
+		if (StrToNumber(tok[0], &reg) != HI_SUCCESS ||
+		    (tok[1] != NULL && StrToNumber(tok[1], &value) != HI_SUCCESS) ||
+		    senreg_add(ops, num, size, reg, tok[1] != NULL, tok[1] != NULL ? value : 0) < 0)
+		{
+			printf("line %d: expected <sensor reg> [value]\n", lineno);
+			if (fp != stdin)
+				fclose(fp);
+			return -1;
+		}
+	}
+	if (fp != stdin)
+		fclose(fp);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	U32 I2C_port;
+	U32 device_addr;
+	U32 reg, value, count = 1, i;
+	struct senreg_op *ops = NULL;
+	struct timespec start;
+	int fd, num = 0, size = 0, failed, ret = -1, a;
+	long usecs;
+
+	if (argc < 5)
+	{
+		printf("usage: %s <bus_num> <device address> r <sensor reg> [count]. sample: %s 0x0 0x3b r 0x3000 16\n", argv[0], argv[0]);
+		printf("       %s <bus_num> <device address> w <sensor reg> <value> [<sensor reg> <value> ...]\n", argv[0]);
+		printf("       %s <bus_num> <device address> -f <script file|->\n", argv[0]);
+		printf("each access waits the firmware's fixed 10 ms, there is no completion flag to poll\n");
+		return -1;
+	}
+
+	if(StrToNumber(argv[1], &I2C_port) != HI_SUCCESS ) {
+		printf("Please input i2c port like 0x100 or 256.\r\n");
+		return -1;
+	}
+
+	if(StrToNumber(argv[2], &device_addr) != HI_SUCCESS || device_addr > 0x7F) {
+		printf("Please input dev addr like 0x3b.\r\n");
+		return -1;
+	}
+
+	if (strcmp(argv[3], "r") == 0)
+	{
+		if (StrToNumber(argv[4], &reg) != HI_SUCCESS ||
+		    (argc > 5 && StrToNumber(argv[5], &count) != HI_SUCCESS) ||
+		    count == 0 || reg + count > 0x10000)
+		{
+			printf("Please input a sensor reg and count inside 0x0000-0xffff.\r\n");
+			return -1;
+		}
+		for (i = 0; i < count; i++)
+		{
+			if (senreg_add(&ops, &num, &size, reg + i, 0, 0) < 0)
+				goto out;
+		}
+	}
+	else if (strcmp(argv[3], "w") == 0)
+	{
+		if ((argc - 4) % 2)
+		{
+			printf("Please input <sensor reg> <value> pairs.\r\n");
+			return -1;
+		}
+		for (a = 4; a < argc; a += 2)
+		{
+			if (StrToNumber(argv[a], &reg) != HI_SUCCESS ||
+			    StrToNumber(argv[a + 1], &value) != HI_SUCCESS ||
+			    senreg_add(&ops, &num, &size, reg, 1, value) < 0)
+			{
+				printf("Bad sensor reg %s value %s\n", argv[a], argv[a + 1]);
+				goto out;
+			}
+		}
+	}
+	else if (strcmp(argv[3], "-f") == 0)
+	{
+		if (senreg_load(argv[4], &ops, &num, &size) < 0)
+			goto out;
+	}
+	else
+	{
+		printf("Unknown command %s\n", argv[3]);
+		return -1;
+	}
+
+	if (getenv(SENREG_WRITE_ENV) == NULL)
+	{
+		for (a = 0; a < num && !ops[a].write; a++)
+			;
+		if (a < num)
+			printf("sensor register writes need the firmware's write code in %s\n", SENREG_WRITE_ENV);
+	}
+
+	fd = i2c_open_bus(I2C_port);
+	if (fd < 0)
+		goto out;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	failed = senreg_xfer(fd, device_addr, ops, num);
+	usecs = senreg_tool_usecs(&start);
+	close(fd);
+	if (failed < 0)
+	{
+		printf("I2C error talking to %#x\n", device_addr);
+		goto out;
+	}
+
+	for (a = 0; a < num; a++)
+	{
+		if (ops[a].ret < 0)
+			printf("%c sensor addr 0x%4x failed\n", ops[a].write ? 'w' : 'r', ops[a].addr);
+		else
+			printf("%c sensor addr 0x%4x value 0x%2x\n", ops[a].write ? 'w' : 'r', ops[a].addr, ops[a].value);
+	}
+	if (num > 1)
+		printf("====I2C senreg:<%#x> %d accesses, %d failed, %ld us====\n", device_addr, num, failed, usecs);
+	ret = failed ? -1 : 0;
+
+out:
+	free(ops);
+	return ret;
+}
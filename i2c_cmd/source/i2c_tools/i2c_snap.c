@@ -0,0 +1,399 @@
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "i2c_comm.h"
+
+/*
+ * i2c_snap - register snapshot, diff and minimal restore for CS cameras.
+ *
+ *   i2c_snap <bus> <addr> save <file>     dump the register space
+ *   i2c_snap <bus> <addr> diff <file>     compare the camera against file
+ *   i2c_snap <bus> <addr> restore <file>  write back what differs
+ *
+ * The snapshot is a small header followed by the raw bytes of each range:
+ *   "CSNP" version(1) nranges(1) productid(2, le)
+ *   per range: start(2, le) len(2, le) data[len]
+ *
+ * Only RW registers of the map are ever restored, a multi byte group is
+ * written as a whole when any of its bytes differ. I2c_addr is reported but
+ * not restored, the rest of the restore would go to the wrong address.
+ * Csi2_Enable and the FMT_* video format groups are not written in place:
+ * when any of them differ the format is set again at the end, stream off,
+ * width, height and frame rate, stream on, with the waits the drivers use.
+ */
+
+#define SNAP_MAGIC	"CSNP"
+#define SNAP_VERSION	1
+
+struct snap_range {
+	uint16_t start;
+	uint16_t len;
+};
+
+/* fpga part and arm part, the arm part includes the ME/AWB/DME tail of the map */
+static const struct snap_range snap_ranges[] = {
+	{ 0x0000, 0x0029 },
+	{ 0x0100, 0x0148 },
+};
+
+#define SNAP_NRANGES	(sizeof(snap_ranges) / sizeof(snap_ranges[0]))
+
+/* the drivers' WAIT_MS_CMD after each format step and wait4stable after all */
+#define SNAP_WAIT_US_CMD	5000
+#define SNAP_WAIT_US_STABLE	30000
+/* register script entries the format sequence adds at most */
+#define SNAP_FORMAT_REGS	24
+
+/* stream and video format groups, restored as one sequence */
+static const uint16_t snap_format_regs[] = {
+	CS_REG_CSI2_ENABLE, CS_REG_FMT_WIDTH, CS_REG_FMT_HEIGHT, CS_REG_FMT_FRAMRAT,
+	CS_REG_NEW_FMT_FRAMRAT_MODE, CS_REG_NEW_FMT_FRAMRAT,
+};
+
+struct snapshot {
+	uint16_t productid;
+	uint8_t *data[SNAP_NRANGES];
+};
+
+static void snap_free(struct snapshot *snap)
+{
+	unsigned int i;
+
+	for (i = 0; i < SNAP_NRANGES; i++)
+	{
+		free(snap->data[i]);
+		snap->data[i] = NULL;
+	}
+}
+
+static int snap_alloc(struct snapshot *snap)
+{
+	unsigned int i;
+
+	memset(snap, 0, sizeof(*snap));
+	for (i = 0; i < SNAP_NRANGES; i++)
+	{
+		snap->data[i] = calloc(1, snap_ranges[i].len);
+		if (snap->data[i] == NULL)
+		{
+			snap_free(snap);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int snap_read_camera(int fd, U8 device_addr, struct snapshot *snap)
+{
+	unsigned int i;
+
+	for (i = 0; i < SNAP_NRANGES; i++)
+	{
+		if (i2c_read_regs(fd, device_addr, snap_ranges[i].start, snap->data[i], snap_ranges[i].len) < 0)
+		{
+			printf("Failed to read range %#x\n", snap_ranges[i].start);
+			return -1;
+		}
+	}
+	snap->productid = snap->data[1][CS_REG_PRODUCTID - 0x0100] |
+			  (snap->data[1][CS_REG_PRODUCTID - 0x0100 + 1] << 8);
+	return 0;
+}
+
+static int snap_save(const CHAR *path, const struct snapshot *snap)
+{
+	uint8_t hdr[8] = { 'C', 'S', 'N', 'P', SNAP_VERSION, SNAP_NRANGES,
+			   snap->productid & 0xff, snap->productid >> 8 };
+	uint8_t rhdr[4];
+	unsigned int i;
+	FILE *fp;
+
+	fp = fopen(path, "wb");
+	if (fp == NULL)
+	{
+		printf("Couldn't create %s\n", path);
+		return -1;
+	}
+	fwrite(hdr, 1, sizeof(hdr), fp);
+	for (i = 0; i < SNAP_NRANGES; i++)
+	{
+		rhdr[0] = snap_ranges[i].start & 0xff;
+		rhdr[1] = snap_ranges[i].start >> 8;
+		rhdr[2] = snap_ranges[i].len & 0xff;
+		rhdr[3] = snap_ranges[i].len >> 8;
+		fwrite(rhdr, 1, sizeof(rhdr), fp);
+		fwrite(snap->data[i], 1, snap_ranges[i].len, fp);
+	}
+	if (fclose(fp) != 0)
+	{
+		printf("Failed to write %s\n", path);
+		return -1;
+	}
+	return 0;
+}
+
+static int snap_load(const CHAR *path, struct snapshot *snap)
+{
+	uint8_t hdr[8], rhdr[4];
+	unsigned int i;
+	FILE *fp;
+
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+	{
+		printf("Couldn't open %s\n", path);
+		return -1;
+	}
+	if (fread(hdr, 1, sizeof(hdr), fp) != sizeof(hdr) || memcmp(hdr, SNAP_MAGIC, 4) != 0 ||
+	    hdr[4] != SNAP_VERSION || hdr[5] != SNAP_NRANGES)
+	{
+		printf("%s is not a snapshot of this version\n", path);
+		fclose(fp);
+		return -1;
+	}
+	snap->productid = hdr[6] | (hdr[7] << 8);
+	for (i = 0; i < SNAP_NRANGES; i++)
+	{
+		if (fread(rhdr, 1, sizeof(rhdr), fp) != sizeof(rhdr) ||
+		    (rhdr[0] | (rhdr[1] << 8)) != snap_ranges[i].start ||
+		    (rhdr[2] | (rhdr[3] << 8)) != snap_ranges[i].len ||
+		    fread(snap->data[i], 1, snap_ranges[i].len, fp) != snap_ranges[i].len)
+		{
+			printf("%s: bad range %u\n", path, i);
+			fclose(fp);
+			return -1;
+		}
+	}
+	fclose(fp);
+	return 0;
+}
+
+static int snap_is_format(uint16_t addr)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(snap_format_regs) / sizeof(snap_format_regs[0]); i++)
+	{
+		if (snap_format_regs[i] == addr)
+			return 1;
+	}
+	return 0;
+}
+
+static uint8_t snap_byte(const struct snapshot *snap, uint16_t addr)
+{
+	unsigned int i;
+
+	for (i = 0; i < SNAP_NRANGES; i++)
+	{
+		if (addr >= snap_ranges[i].start && addr - snap_ranges[i].start < snap_ranges[i].len)
+			return snap->data[i][addr - snap_ranges[i].start];
+	}
+	return 0;
+}
+
+static void snap_queue(struct sensor_regs *regs, int *num_regs, uint16_t reg, uint32_t data)
+{
+	regs[*num_regs].reg = reg;
+	regs[*num_regs].data = data;
+	(*num_regs)++;
+}
+
+/*
+ * set the golden video format the way the drivers change modes: stream
+ * off, new frame rate mode off so FMT_FRAMRAT counts, width, height and
+ * frame rate each followed by WAIT_MS_CMD, then the new frame rate if the
+ * snapshot used it, wait4stable and the golden Csi2_Enable.
+ * Returns the number of register groups queued: Csi2_Enable, the frame
+ * rate mode, the three FMT groups and NEW_FMT_FRAMRAT when used.
+ */
+static int snap_queue_format(const struct snapshot *gold, struct sensor_regs *regs, int *num_regs)
+{
+	static const uint16_t fmt[] = { CS_REG_FMT_WIDTH, CS_REG_FMT_HEIGHT, CS_REG_FMT_FRAMRAT };
+	unsigned int i;
+	int groups = 5;
+
+	snap_queue(regs, num_regs, CS_REG_CSI2_ENABLE, 0);
+	snap_queue(regs, num_regs, REG_OP_DELAY, SNAP_WAIT_US_CMD);
+	snap_queue(regs, num_regs, CS_REG_NEW_FMT_FRAMRAT_MODE, 0);
+	for (i = 0; i < sizeof(fmt) / sizeof(fmt[0]); i++)
+	{
+		snap_queue(regs, num_regs, fmt[i], snap_byte(gold, fmt[i]));
+		snap_queue(regs, num_regs, fmt[i] + 1, snap_byte(gold, fmt[i] + 1));
+		snap_queue(regs, num_regs, REG_OP_DELAY, SNAP_WAIT_US_CMD);
+	}
+	if (snap_byte(gold, CS_REG_NEW_FMT_FRAMRAT_MODE))
+	{
+		snap_queue(regs, num_regs, CS_REG_NEW_FMT_FRAMRAT_MODE,
+			   snap_byte(gold, CS_REG_NEW_FMT_FRAMRAT_MODE));
+		snap_queue(regs, num_regs, CS_REG_NEW_FMT_FRAMRAT, snap_byte(gold, CS_REG_NEW_FMT_FRAMRAT));
+		snap_queue(regs, num_regs, CS_REG_NEW_FMT_FRAMRAT + 1,
+			   snap_byte(gold, CS_REG_NEW_FMT_FRAMRAT + 1));
+		groups++;
+	}
+	snap_queue(regs, num_regs, REG_OP_DELAY, SNAP_WAIT_US_STABLE);
+	snap_queue(regs, num_regs, CS_REG_CSI2_ENABLE, snap_byte(gold, CS_REG_CSI2_ENABLE));
+	snap_queue(regs, num_regs, REG_OP_DELAY, SNAP_WAIT_US_CMD);
+	return groups;
+}
+
+/*
+ * walk both snapshots register group by register group. With regs != NULL
+ * the golden bytes of every differing RW group are appended to it, and
+ * *nqueued counts the groups that were; a differing stream or format group
+ * sets *format instead, see snap_queue_format().
+ * Returns the number of differing groups.
+ */
+static int snap_diff(const struct snapshot *cur, const struct snapshot *gold,
+		     struct sensor_regs *regs, int *num_regs, int *nqueued, int *format,
+		     int verbose)
+{
+	const struct reg_desc *desc;
+	unsigned int i, off, j, len;
+	int ndiff = 0;
+	uint16_t addr;
+
+	for (i = 0; i < SNAP_NRANGES; i++)
+	{
+		for (off = 0; off < snap_ranges[i].len; off += len)
+		{
+			addr = snap_ranges[i].start + off;
+			desc = cs_reg_at(addr);
+			if (desc == NULL || desc->addr != addr)
+			{
+				len = 1;
+				continue;
+			}
+			len = desc->width;
+			if (off + len > snap_ranges[i].len)
+				len = snap_ranges[i].len - off;
+			if (desc->access != REG_ACC_RW ||
+			    memcmp(cur->data[i] + off, gold->data[i] + off, len) == 0)
+				continue;
+
+			ndiff++;
+			if (verbose)
+			{
+				printf("%-22s %#06x:", desc->name, addr);
+				for (j = 0; j < len; j++)
+					printf(" %02x", cur->data[i][off + j]);
+				printf(" ->");
+				for (j = 0; j < len; j++)
+					printf(" %02x", gold->data[i][off + j]);
+				printf("\n");
+			}
+			if (regs == NULL || addr == CS_REG_I2C_ADDR)
+				continue;
+			if (snap_is_format(addr))
+			{
+				*format = 1;
+				continue;
+			}
+			for (j = 0; j < len; j++)
+				snap_queue(regs, num_regs, addr + j, gold->data[i][off + j]);
+			(*nqueued)++;
+		}
+	}
+	return ndiff;
+}
+
+int main(int argc, char *argv[])
+{
+	U32 I2C_port;
+	U32 device_addr;
+	struct snapshot cur, gold;
+	struct sensor_regs *regs = NULL;
+	unsigned int i, total = 0;
+	int fd, ndiff, num_regs = 0, nqueued = 0, format = 0, ret = -1;
+
+	if (argc < 5)
+	{
+		printf("usage: %s <bus_num> <device address> <save|diff|restore> <snapshot file>. sample: %s 0x0 0x3b save golden.snap\n", argv[0], argv[0]);
+		return -1;
+	}
+
+	if(StrToNumber(argv[1], &I2C_port) != HI_SUCCESS ) {
+		printf("Please input i2c port like 0x100 or 256.\r\n");
+		return -1;
+	}
+
+	if(StrToNumber(argv[2], &device_addr) != HI_SUCCESS || device_addr > 0x7F) {
+		printf("Please input dev addr like 0x3b.\r\n");
+		return -1;
+	}
+
+	if (strcmp(argv[3], "save") && strcmp(argv[3], "diff") && strcmp(argv[3], "restore"))
+	{
+		printf("Unknown command %s\n", argv[3]);
+		return -1;
+	}
+
+	if (snap_alloc(&cur) < 0)
+		return -1;
+	if (snap_alloc(&gold) < 0)
+	{
+		snap_free(&cur);
+		return -1;
+	}
+
+	fd = i2c_open_bus(I2C_port);
+	if (fd < 0)
+		goto out;
+	if (snap_read_camera(fd, device_addr, &cur) < 0)
+		goto out_close;
+
+	if (strcmp(argv[3], "save") == 0)
+	{
+		ret = snap_save(argv[4], &cur);
+		if (ret == 0)
+			printf("====I2C snap: product %#06x saved to %s====\n", cur.productid, argv[4]);
+		goto out_close;
+	}
+
+	if (snap_load(argv[4], &gold) < 0)
+		goto out_close;
+	if (gold.productid != cur.productid)
+	{
+		printf("Snapshot is for product %#06x, camera is %#06x\n", gold.productid, cur.productid);
+		goto out_close;
+	}
+
+	if (strcmp(argv[3], "diff") == 0)
+	{
+		ndiff = snap_diff(&cur, &gold, NULL, NULL, NULL, NULL, 1);
+		printf("====I2C snap: %d register groups differ====\n", ndiff);
+		ret = ndiff ? 1 : 0;
+		goto out_close;
+	}
+
+	for (i = 0; i < SNAP_NRANGES; i++)
+		total += snap_ranges[i].len;
+	regs = calloc(total + SNAP_FORMAT_REGS, sizeof(*regs));
+	if (regs == NULL)
+		goto out_close;
+	snap_diff(&cur, &gold, regs, &num_regs, &nqueued, &format, 1);
+	if (format)
+		nqueued += snap_queue_format(&gold, regs, &num_regs);
+	if (num_regs && send_regs(fd, device_addr, regs, num_regs) < 0)
+		goto out_close;
+	printf("====I2C snap: restored %d register groups%s====\n", nqueued,
+	       format ? ", video format set again" : "");
+	ret = 0;
+
+out_close:
+	close(fd);
+out:
+	free(regs);
+	snap_free(&cur);
+	snap_free(&gold);
+	return ret;
+}
@@ -13,37 +13,31 @@
 
 #include "i2c_comm.h"
 
-#define I2C_DEVICE_NAME_LEN 13	// "/dev/i2c-XXX"+NULL
-static char i2c_device_name[I2C_DEVICE_NAME_LEN];
-
-void send_regs(int fd,  const struct sensor_regs *regs, int num_regs)
+/* i2c_write <bus> <addr> -f <script|->: run a whole register script */
+static int write_script(int fd, U8 device_addr, const CHAR *path)
 {
-	int i;
-	for (i=0; i<num_regs; i++)
+	struct sensor_regs *regs = NULL;
+	FILE *fp;
+	int num, xfers;
+
+	fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+	if (fp == NULL)
 	{
-		if (regs[i].reg == 0xFFFF)
-		{
-			if (ioctl(fd, I2C_SLAVE_FORCE, regs[i].data) < 0)
-			{
-				printf("Failed to set I2C address to %02X", regs[i].data);
-			}
-		}
-		else if (regs[i].reg == 0xFFFE)
-		{
-			usleep(regs[i].data);
-		}
-		else
-		{
-			unsigned char msg[4] = {regs[i].reg>>8, regs[i].reg, regs[i].data};
-			int len = 3;
-
-			if (write(fd, msg, len) != len)
-			{
-				printf("Failed to write register index %d", i);
-			}
-			
-		}
+		printf("Couldn't open script %s\n", path);
+		return -1;
 	}
+	num = load_regs(fp, &regs);
+	if (fp != stdin)
+		fclose(fp);
+	if (num < 0)
+		return -1;
+
+	xfers = send_regs(fd, device_addr, regs, num);
+	free(regs);
+	if (xfers < 0)
+		return -1;
+	printf("====I2C write script:<%#x> %d regs in %d transfers====\n", device_addr, num, xfers);
+	return 0;
 }
 
 int main(int argc, char *argv[])
@@ -52,13 +46,13 @@ int main(int argc, char *argv[])
 	U32 device_addr;
 	U32 reg_addr;
 	U32 new_data;
-	U8 value;
 	struct sensor_regs regs;
-	
-	int result;
+	int fd, ret;
+
 	if (argc < 5)
 	{
 		printf("usage: %s <bus_num> <device address 8bits> <register address 16bits> <value>. sample: %s 0x0 0xA0 0x10 0x40\n", argv[0], argv[0]);
+		printf("       %s <bus_num> <device address 8bits> -f <script file|->. sample: %s 0x0 0x3b -f videofmt.txt\n", argv[0], argv[0]);
 		return -1;
 	}
 
@@ -72,6 +66,16 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
+	if (strcmp(argv[3], "-f") == 0)
+	{
+		fd = i2c_open_bus(I2C_port);
+		if (fd < 0)
+			return -1;
+		ret = write_script(fd, device_addr, argv[4]);
+		close(fd);
+		return ret;
+	}
+
 	if(StrToNumber(argv[3], &reg_addr) != HI_SUCCESS ) {
 		printf("Please input reg addr like 0x100 0r 256.\r\n");
 		return -1;
@@ -81,31 +85,21 @@ int main(int argc, char *argv[])
 		printf("Please input len like 0x100\n");
 		return -1;
 	}
-	value = (U8)new_data;
-	printf("====I2C write:<%#x> <%#x> <%#x>====\n", device_addr, reg_addr, new_data);
-	
-	snprintf(i2c_device_name, sizeof(i2c_device_name), "/dev/i2c-%d", I2C_port);
-	//printf("Using i2C device %s\n", i2c_device_name);
-	
-	int fd;
-	fd = open(i2c_device_name, O_RDWR);
-	if (!fd)
-	{
-		printf("Couldn't open I2C device\n");
+	if (reg_addr > 0xFFFF || new_data > (reg_addr >= REG_OP_REGWIDTH ? 0xFFFF : 0xFF)) {
+		printf("register %#x or value %#x out of range\n", reg_addr, new_data);
 		return -1;
 	}
-	if (ioctl(fd, I2C_SLAVE_FORCE, device_addr) < 0)
-	{
-		printf("Failed to set I2C address\n");
+	printf("====I2C write:<%#x> <%#x> <%#x>====\n", device_addr, reg_addr, new_data);
+
+	fd = i2c_open_bus(I2C_port);
+	if (fd < 0)
 		return -1;
-	}
 	regs.reg = reg_addr;
 	regs.data = new_data;
-	
-	send_regs(fd, &regs, 1);
+
+	ret = send_regs(fd, device_addr, &regs, 1) < 0 ? -1 : 0;
 	close(fd);
-	
-	return 0;
 
-}
+	return ret;
 
+}
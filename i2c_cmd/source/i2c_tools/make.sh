@@ -1,4 +1,9 @@
 
-aarch64-linux-gnu-gcc -o i2c_read i2c_read.c strfunc.c 
-aarch64-linux-gnu-gcc -o i2c_write i2c_write.c strfunc.c 
+${CC:-aarch64-linux-gnu-gcc} -o i2c_read i2c_read.c i2c_comm.c i2c_cache.c cs_regmap.c strfunc.c 
+${CC:-aarch64-linux-gnu-gcc} -o i2c_write i2c_write.c i2c_comm.c i2c_cache.c cs_regmap.c strfunc.c 
+${CC:-aarch64-linux-gnu-gcc} -o i2c_regd i2c_regd.c i2c_comm.c i2c_cache.c cs_regmap.c strfunc.c 
+${CC:-aarch64-linux-gnu-gcc} -o i2c_snap i2c_snap.c i2c_comm.c i2c_cache.c cs_regmap.c strfunc.c 
+${CC:-aarch64-linux-gnu-gcc} -o i2c_multicfg i2c_multicfg.c i2c_comm.c i2c_cache.c cs_regmap.c strfunc.c -lpthread 
+${CC:-aarch64-linux-gnu-gcc} -o i2c_sample i2c_sample.c i2c_comm.c i2c_cache.c cs_regmap.c strfunc.c -lpthread 
+${CC:-aarch64-linux-gnu-gcc} -o i2c_senreg i2c_senreg.c i2c_comm.c i2c_cache.c cs_regmap.c strfunc.c 
 
@@ -0,0 +1,162 @@
+#!/bin/sh
+#
+# gen_regmap.sh - regenerate everything derived from cs_regs.txt and
+# veye_regs.txt:
+#   i2c_tools/cs_regs.h                 tool lookup table, CS_REG_* constants
+#   cs_mipi_i2c.sh                      reglist between the reglist and
+#                                       parse arg markers
+#   cs_imx307.h, cs_sc132.h             ECAMERA_REG body between markers
+#   veyecam2m.c                         register defines between markers
+#
+# usage: ./gen_regmap.sh   (from anywhere inside the repository)
+
+set -e
+
+export LC_ALL=C
+
+REGMAP_DIR=$(cd "$(dirname "$0")" && pwd)
+TOP=$(cd "$REGMAP_DIR/../../.." && pwd)
+CS_DESC=$REGMAP_DIR/cs_regs.txt
+VEYE_DESC=$REGMAP_DIR/veye_regs.txt
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# print "name addr access group scope" for every register line, sections as "## title"
+strip_desc()
+{
+    awk '/^##/ { print; next } /^#/ || NF == 0 { next } { print }' "$1"
+}
+
+gen_cs_header()
+{
+    strip_desc "$CS_DESC" | awk '
+    /^##/ { next }
+    $5 != "all" { next }
+    {
+        grp = ($4 == "-") ? $1 : $4;
+        if (!(grp in width)) {
+            order[n++] = grp;
+            addr[grp] = $2;
+            acc[grp] = toupper($3);
+        }
+        width[grp]++;
+    }
+    END {
+        print "/* generated by gen_regmap.sh from cs_regs.txt, do not edit */";
+        print "";
+        print "#ifndef _CS_REGS_H";
+        print "#define _CS_REGS_H";
+        print "";
+        for (i = 0; i < n; i++) {
+            g = order[i];
+            printf "#define CS_REG_%-24s %s\n", toupper(g), addr[g];
+            printf "#define CS_REG_%-24s %d\n", toupper(g) "_WIDTH", width[g];
+        }
+        print "";
+        print "#endif";
+        print "";
+        print "/* the table itself, only for the one file that defines CS_REGS_TABLE */";
+        print "#if defined(CS_REGS_TABLE) && !defined(_CS_REGS_TABLE)";
+        print "#define _CS_REGS_TABLE";
+        print "static const struct reg_desc cs_regs[] = {";
+        for (i = 0; i < n; i++) {
+            g = order[i];
+            printf "\t{ %-24s %s, %d, REG_ACC_%s },\n", "\"" g "\",", addr[g], width[g], acc[g];
+        }
+        print "};";
+        print "#endif";
+    }'
+}
+
+gen_cs_sh()
+{
+    strip_desc "$CS_DESC" | awk '
+    /^##/ { sub(/^## */, ""); printf "########################this is %s reglist#####################\n", $0; next }
+    $5 != "all" { next }
+    { printf "%s=%s;\n", $1, $2 }
+    END { print "" }'
+}
+
+gen_cs_enum()
+{
+    strip_desc "$CS_DESC" | awk '
+    BEGIN { print "    /* generated by gen_regmap.sh from cs_regs.txt, do not edit */" }
+    /^##/ { sub(/^## */, ""); printf "    //%s\n", $0; next }
+    { printf "    %s = %s,\n", $1, $2 }
+    END { print "    /* end of generated registers */" }'
+}
+
+gen_veye_defines()
+{
+    strip_desc "$VEYE_DESC" | awk '
+    BEGIN { print "/* generated by gen_regmap.sh from veye_regs.txt, do not edit */" }
+    /^##/ { sub(/^## */, ""); printf "/* %s */\n", $0; next }
+    {
+        prefix = ($4 == "isp") ? "VEYECAM2M_ISP_" : "VEYECAM2M_REG_";
+        printf "#define %-32s %s\n", prefix $1, $2;
+    }
+    END { print "/* end of generated registers */" }'
+}
+
+# splice <file> <begin regex> <end regex> <fragment>: replace what is between
+# the begin and the end line, both lines are kept
+splice()
+{
+    if ! grep -q "$2" "$1"; then
+        echo "skip $1: no marker" >&2
+        return 0
+    fi
+    awk -v b="$2" -v e="$3" -v frag="$4" '
+    skip && $0 ~ e { skip = 0 }
+    skip { next }
+    { print }
+    !done && $0 ~ b {
+        while ((getline line < frag) > 0)
+            print line;
+        skip = 1;
+        done = 1;
+    }' "$1" > "$TMP/out"
+    cat "$TMP/out" > "$1"
+    echo "updated $1"
+}
+
+# the C markers are part of the fragments, so those splice the line before
+splice_c()
+{
+    if ! grep -q "$2" "$1"; then
+        echo "skip $1: no marker" >&2
+        return 0
+    fi
+    awk -v b="$2" -v e="$3" -v frag="$4" '
+    !done && $0 ~ b {
+        while ((getline line < frag) > 0)
+            print line;
+        skip = 1;
+        done = 1;
+        next;
+    }
+    skip { if ($0 ~ e) skip = 0; next }
+    { print }' "$1" > "$TMP/out"
+    cat "$TMP/out" > "$1"
+    echo "updated $1"
+}
+
+gen_cs_header > "$TOP/i2c_cmd/source/i2c_tools/cs_regs.h"
+echo "updated $TOP/i2c_cmd/source/i2c_tools/cs_regs.h"
+
+gen_cs_sh > "$TMP/sh"
+for f in "$TOP"/i2c_cmd/bin/cs_mipi_i2c.sh "$TOP"/i2c_cmd/source/i2c_tools/cs_mipi_i2c.sh; do
+    splice "$f" '^######################reglist###' '^######################parse arg###' "$TMP/sh"
+done
+
+gen_cs_enum > "$TMP/enum"
+for f in "$TOP"/driver_source/*/*/cs_imx307.h "$TOP"/driver_source/*/*/cs_sc132.h; do
+    [ -f "$f" ] || continue
+    splice_c "$f" 'generated by gen_regmap.sh from cs_regs.txt' 'end of generated registers' "$TMP/enum"
+done
+
+gen_veye_defines > "$TMP/veye"
+for f in "$TOP"/driver_source/*/*/veyecam2m.c; do
+    [ -f "$f" ] || continue
+    splice_c "$f" 'generated by gen_regmap.sh from veye_regs.txt' 'end of generated registers' "$TMP/veye"
+done